@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <TStopwatch.h>
+#include "run-fcc-higgs.cpp"
+
+using namespace std;
+
+/*
+Measures what a systematic universe (fcc-higgs-universes.h) costs on top
+of the nominal selection:
+
+    root -l -b -q "bench-universes.cpp(\"INPUT\", \"bench.tsv\", \"events=20000 max=6\")"
+
+INPUT is one file of any layout the engine reads. For K = 0 .. max the
+first events of it are read and run through EngineSelection with K
+universes (the VARIATIONS in turn), on one thread. Per K it prints and
+writes to the TSV the seconds, the seconds per extra universe over K = 0,
+and the seconds K + 1 separate reruns of the nominal selection would take.
+Options (space separated):
+    events=N   events per pass (default 20000, at most the file)
+    max=K      largest number of universes (default 6)
+    repeat=R   passes per K, the fastest is kept (default 3)
+*/
+
+void bench_universes(TString infilename, TString outfilename, TString options = "")
+{
+    gErrorIgnoreLevel = kFatal;
+    TH1::AddDirectory(kFALSE);
+
+    Long64_t nevents = 20000;
+    int max_universes = 6;
+    int repeat = 3;
+    istringstream tokens(options.Data());
+    string token;
+    while (tokens >> token)
+    {
+        size_t eq = token.find('=');
+        string key = token.substr(0, eq);
+        string value = eq == string::npos ? "" : token.substr(eq + 1);
+        if (key == "events") nevents = atoll(value.c_str());
+        else if (key == "max") max_universes = atoi(value.c_str());
+        else if (key == "repeat") repeat = TMath::Max(1, atoi(value.c_str()));
+        else printf("Unknown option %s\n", token.c_str());
+    }
+
+    InputReader reader;
+    if (!reader.Open(infilename.Data()))
+    {
+        printf("Cannot read %s\n", infilename.Data());
+        return;
+    }
+    nevents = TMath::Min(nevents, reader.Entries());
+
+    FILE *out = fopen(outfilename.Data(), "w");
+    if (out != nullptr) fprintf(out, "universes\tevents\tseconds\tseconds_per_universe\tseconds_reruns\n");
+    printf("%9s %8s %10s %14s %10s\n", "universes", "events", "seconds", "s/universe", "reruns s");
+    double nominal = 0;
+    for (int k=0; k<=max_universes; k++)
+    {
+        RunOptions opt;
+        for (int u=0; u<k; u++) opt.variations.push_back(VARIATIONS[u % VARIATIONS.size()]);
+        double best = 0;
+        for (int r=0; r<repeat; r++)
+        {
+            EngineSelection selection(opt);
+            TStopwatch timer;
+            timer.Start();
+            reader.Visit([&](auto *event)
+            {
+                for (Long64_t ievent=0; ievent<nevents; ievent++)
+                {
+                    event->GetEntry(ievent);
+                    selection.Process(event);
+                }
+            });
+            timer.Stop();
+            if (r == 0 or timer.RealTime() < best) best = timer.RealTime();
+        }
+        if (k == 0) nominal = best;
+        double per_universe = k == 0 ? 0 : (best - nominal) / k;
+        printf("%9d %8lld %10.3f %14.4f %10.3f\n", k, nevents, best, per_universe, (k + 1) * nominal);
+        if (out != nullptr) fprintf(out, "%d\t%lld\t%.4f\t%.5f\t%.4f\n", k, nevents, best, per_universe, (k + 1) * nominal);
+    }
+    if (out != nullptr) fclose(out);
+    reader.Close();
+}
@@ -0,0 +1,121 @@
+"""
+Dataset catalogue: per input file of every process its cross-section, entries,
+size, sum of event weights and mtime, in the tab separated layout of
+fcc-higgs-samples.h (DatasetCatalogue), which run-fcc-higgs.cpp reads as its
+sample catalogue.
+
+refresh_catalogue() lists the directories of processes.py once and keeps the
+columns of every file whose size and mtime did not change; new and changed
+files get -1 until make-catalogue.cpp has read them. The other tools then
+take file lists, event counts and sums of weights from here instead of
+listing directories or opening ROOT files.
+
+The productions of a process with several directories are its components,
+with the sample name PROCESS/DIRECTORY (e.g. ttbar_hvq/hvqMulti1M), which
+the engine normalises one by one and stitches (fcc-higgs-samples.h); a
+process name matches all of its components.
+"""
+
+import os
+
+COLUMNS = ["sample", "cross_section", "input", "entries", "bytes", "sum_weights", "mtime"]
+
+
+def read_catalogue(path):
+    """Rows of the catalogue at path as dicts, [] if there is none."""
+    rows = []
+    if not os.path.exists(path):
+        return rows
+    with open(path) as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if not line or line.startswith("#"):
+                continue
+            fields = line.split("\t")
+            if len(fields) < 3:
+                continue
+            fields += ["-1"] * (len(COLUMNS) - len(fields))
+            rows.append({
+                "sample": fields[0],
+                "cross_section": float(fields[1]),
+                "input": fields[2],
+                "entries": int(fields[3]),
+                "bytes": int(fields[4]),
+                "sum_weights": float(fields[5]),
+                "mtime": int(fields[6]),
+            })
+    return rows
+
+
+def write_catalogue(rows, path):
+    """Sorted by sample and input, atomically replacing path."""
+    rows = sorted(rows, key=lambda row: (row["sample"], row["input"]))
+    with open(f"{path}.tmp", "w") as f:
+        f.write("# " + "\t".join(COLUMNS) + "\n")
+        for row in rows:
+            f.write("\t".join(str(row[column]) for column in COLUMNS) + "\n")
+    os.replace(f"{path}.tmp", path)
+
+
+def is_current(row):
+    """True if the file still has the size and mtime its columns were taken with."""
+    try:
+        stat = os.stat(row["input"])
+    except OSError:
+        return False
+    return stat.st_size == row["bytes"] and int(stat.st_mtime) == row["mtime"]
+
+
+def component_name(process, path, file):
+    """
+    Sample name of file of process: PROCESS/DIRECTORY if path, the "path"
+    of the process in processes.py, lists several directories, else PROCESS.
+    """
+    if isinstance(path, str) or len(path) < 2:
+        return process
+    for element in path:
+        if file == element or file.startswith(element.rstrip("/") + "/"):
+            return f"{process}/{os.path.basename(element.rstrip('/'))}"
+    return process
+
+
+def matches(row, sample):
+    """True if row belongs to sample, a sample name or the process of components."""
+    return row["sample"] == sample or row["sample"].startswith(sample + "/")
+
+
+def refresh_catalogue(processes, get_files, path):
+    """
+    Bring the file lists of path up to date with processes ({name: {"cross-section", "path", ...}});
+    get_files(name) lists the files of a process. Returns the rows that still
+    need make-catalogue.cpp.
+    """
+    old = {(row["sample"], row["input"]): row for row in read_catalogue(path)}
+    rows = []
+    for name, info in processes.items():
+        for file in get_files(name):
+            sample = component_name(name, info["path"], file)
+            row = old.get((sample, file))
+            if row is None or not is_current(row):
+                row = {"sample": sample, "input": file, "entries": -1, "bytes": -1, "sum_weights": -1, "mtime": -1}
+            row["cross_section"] = info["cross-section"]
+            rows.append(row)
+    write_catalogue(rows, path)
+    return [row for row in rows if row["entries"] < 0]
+
+
+def files_of(rows, sample):
+    """Input files of sample, in catalogue order."""
+    return [row["input"] for row in rows if matches(row, sample)]
+
+
+def sample_totals(rows, sample):
+    """
+    (entries, sum of weights) of sample, or None unless every one of its
+    files is known and unchanged.
+    """
+    selected = [row for row in rows if matches(row, sample)]
+    # entries < 0 marks an unknown file; a sum of weights can be negative
+    if not selected or any(row["entries"] < 0 or not is_current(row) for row in selected):
+        return None
+    return sum(row["entries"] for row in selected), sum(row["sum_weights"] for row in selected)
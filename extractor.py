@@ -1,6 +1,7 @@
 #!/work/app/modules/software/Python/3.9.6-GCCcore-11.2.0/bin/python
 import ROOT
 import os
+import sys
 import pandas as pd
 
 
@@ -66,6 +67,19 @@ def extract_columns(input_file_path, output_file_path, branches_dict):
     input_file.Close()
     output_file.Close()
 
+def skim_columns(input_file_path, output_file_path, threads=8):
+    # Same columns, but only events passing the lepton veto, see skim-fcc-higgs.cpp;
+    # False if the skim failed, e.g. on an input it could not read
+    script_dir = os.path.dirname(os.path.abspath(__file__))
+    command = (
+        f'root -l -b -q "{script_dir}/skim-fcc-higgs.cpp(\\"{input_file_path}\\", \\"{output_file_path}\\", \\"threads={threads}\\")"'
+    )
+    if os.system(command) != 0:
+        print(f"Error: Could not skim {input_file_path}")
+        return False
+    return True
+
+
 def get_files(path) -> list:
     files = []
     mapped = [path] if isinstance(path, str) else path  # Mapped to list
@@ -79,8 +93,9 @@ def get_files(path) -> list:
 
     return files
 
-def process_files(process_name, files):
-    output_dir = os.path.join(extracted_file_universal_path, process_name)
+def process_files(process_name, files, skim=False):
+    # Skims go to their own directory, next to the extracted files
+    output_dir = os.path.join(extracted_file_universal_path, process_name + ("_skim" if skim else ""))
     os.makedirs(output_dir, exist_ok=True)
     
     info_list = []
@@ -100,9 +115,13 @@ def process_files(process_name, files):
             continue
         
         original_size = os.path.getsize(input_file)
-        output_file = os.path.join(output_dir, f"extracted_{idx}_{os.path.basename(input_file)}")
-        
-        extract_columns(input_file, output_file, BRANCHES)
+        if skim:
+            output_file = os.path.join(output_dir, f"skimmed_{idx}_{os.path.basename(input_file)}")
+            if not skim_columns(input_file, output_file):
+                continue
+        else:
+            output_file = os.path.join(output_dir, f"extracted_{idx}_{os.path.basename(input_file)}")
+            extract_columns(input_file, output_file, BRANCHES)
         
         extracted_size = os.path.getsize(output_file)
         
@@ -112,7 +131,7 @@ def process_files(process_name, files):
             "original_size": original_size,
             "extracted_size": extracted_size
         })
-    info_df = pd.DataFrame(info_list)
+    info_df = pd.DataFrame(info_list, columns=["ID", "original_file", "original_size", "extracted_size"])
     info_df['reduction_pct'] = (1 - info_df['extracted_size'] / info_df['original_size']) * 100
     
     if existing_csv:
@@ -131,7 +150,7 @@ def process_files(process_name, files):
 #     },
 # }
 
-# ttbar
+# ttbar; with --skim, write lepton-veto skims (skim-fcc-higgs.cpp) instead
 process_name = "ttbar_hvq"
 files = get_files(ALL_PROCESSES[process_name]["path"])
-process_files(process_name, files)
+process_files(process_name, files, skim="--skim" in sys.argv)
@@ -0,0 +1,163 @@
+#ifndef fcc_higgs_bootstrap_h
+#define fcc_higgs_bootstrap_h
+
+#include <algorithm>
+#include <vector>
+#include <TDirectory.h>
+#include <TH1.h>
+#include <TH2D.h>
+#include <TMath.h>
+
+/*
+Poisson bootstrap replicas of the cut flow histograms.
+
+Every event gets N weights drawn from Poisson(1), and every histogram fill
+also adds those weights to N replicas of the filled bin. The spread of a
+bin over its replicas estimates its statistical uncertainty, for yields
+and for efficiencies (ratios of the same replica), without rerunning on
+subsamples.
+
+The weights come from a counter-based generator: weight r of an event is a
+hash of (source, Event.Number, r), the source being that of its file
+(dedup_source of fcc-higgs-dedup.h: its production and seed), so it does
+not depend on the thread, chunk or order the event is processed in, and a
+rerun or a merge of partial outputs gives the same replicas. Event.Number
+restarts in every seed, so it alone would give the events of the same
+number in different files the same weights and correlate the replicas.
+
+The replicas of a PlotSet are stored bin-major, [histogram][bin][replica],
+so a fill adds the N weights to N consecutive doubles, a loop the compiler
+vectorises. Each histogram NAME is saved next to it as the TH2D
+NAME_bootstrap: x the bins of NAME (with under- and overflow), y the
+replica; ProjectionY("", bin, bin)->GetStdDev() is the error of a bin.
+*/
+
+const int BOOTSTRAP_MAX_WEIGHT = 12;  // P(k > 12) for Poisson(1) is below 1e-10
+
+// splitmix64 finaliser of the key and counter
+inline ULong64_t bootstrap_hash(ULong64_t key, ULong64_t counter)
+{
+    ULong64_t z = key * 0x9E3779B97F4A7C15ULL + (counter + 1) * 0xD1B54A32D192ED03ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// The N Poisson(1) weights of the current event
+class BootstrapWeights
+{
+    public:
+        BootstrapWeights(int replicas) : weights(replicas, 1)
+        {
+            double p = TMath::Exp(-1);
+            double cdf = 0;
+            for (int k=0; k<BOOTSTRAP_MAX_WEIGHT; k++)
+            {
+                cdf += p;
+                thresholds[k] = cdf;
+                p /= k + 1;
+            }
+        }
+
+        void Generate(ULong64_t source, Long64_t number)
+        {
+            ULong64_t key = bootstrap_hash(source, number);
+            for (size_t r=0; r<weights.size(); r++)
+            {
+                double u = (bootstrap_hash(key, r) >> 11) * 0x1.0p-53;
+                int k = 0;
+                while (k < BOOTSTRAP_MAX_WEIGHT and u >= thresholds[k]) k++;
+                weights[r] = k;
+            }
+        }
+
+        int Size() const { return weights.size(); }
+        const double *Data() const { return weights.data(); }
+
+    private:
+        std::vector<double> weights;
+        double thresholds[BOOTSTRAP_MAX_WEIGHT];
+};
+
+// Replicas of every histogram of a PlotSet
+class BootstrapReplicas
+{
+    public:
+        BootstrapReplicas(const std::vector<TH1 *> &histograms, const BootstrapWeights *weights) : weights(weights), n(weights->Size())
+        {
+            size_t offset = 0;
+            for (TH1 *hist : histograms)
+            {
+                offsets.push_back(offset);
+                offset += (size_t) (hist->GetNbinsX() + 2) * n;
+            }
+            counts.assign(offset, 0);
+        }
+
+        void Fill(int histnum, int bin, double weight)
+        {
+            double *row = counts.data() + offsets[histnum] + (size_t) bin * n;
+            const double *w = weights->Data();
+            for (int r=0; r<n; r++) row[r] += weight * w[r];
+        }
+
+        void Reset()
+        {
+            std::fill(counts.begin(), counts.end(), 0);
+        }
+
+        void Scale(double factor)
+        {
+            for (double &count : counts) count *= factor;
+        }
+
+        void Add(const BootstrapReplicas &other)
+        {
+            if (other.counts.size() != counts.size()) return;
+            for (size_t i=0; i<counts.size(); i++) counts[i] += other.counts[i];
+        }
+
+        void Save(TDirectory *outfile, const std::vector<TH1 *> &histograms) const
+        {
+            outfile->cd();
+            for (size_t h=0; h<histograms.size(); h++)
+            {
+                TH1 *hist = histograms[h];
+                int nbins = hist->GetNbinsX();
+                TH2D replicas(Form("%s_bootstrap", hist->GetName()), Form("%s, bootstrap replicas", hist->GetTitle()),
+                              nbins, hist->GetXaxis()->GetXmin(), hist->GetXaxis()->GetXmax(), n, 0, n);
+                for (int bin=0; bin<=nbins+1; bin++)
+                {
+                    const double *row = counts.data() + offsets[h] + (size_t) bin * n;
+                    for (int r=0; r<n; r++) replicas.SetBinContent(bin, r + 1, row[r]);
+                }
+                replicas.Write();
+            }
+        }
+
+        void Load(TDirectory *infile, const std::vector<TH1 *> &histograms)
+        {
+            for (size_t h=0; h<histograms.size(); h++)
+            {
+                TH2D *stored = nullptr;
+                infile->GetObject(Form("%s_bootstrap", histograms[h]->GetName()), stored);
+                if (stored == nullptr) continue;
+                int nbins = TMath::Min(histograms[h]->GetNbinsX(), stored->GetNbinsX());
+                int replicas = TMath::Min(n, stored->GetNbinsY());
+                for (int bin=0; bin<=nbins+1; bin++)
+                {
+                    double *row = counts.data() + offsets[h] + (size_t) bin * n;
+                    for (int r=0; r<replicas; r++) row[r] += stored->GetBinContent(bin, r + 1);
+                }
+                delete stored;
+            }
+        }
+
+    private:
+        const BootstrapWeights *weights;
+        const int n;
+        std::vector<size_t> offsets;
+        std::vector<double> counts;
+};
+
+#endif
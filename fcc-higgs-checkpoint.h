@@ -0,0 +1,85 @@
+#ifndef fcc_higgs_checkpoint_h
+#define fcc_higgs_checkpoint_h
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <TFile.h>
+#include <TObjString.h>
+#include <TSystem.h>
+
+/*
+Checkpoints of a running selection.
+
+A checkpoint is a ROOT file with the histograms of the selection, exactly
+as SaveAll() writes them, plus a TObjString "checkpoint_ranges" listing the
+entry ranges already filled into them, one "file<TAB>first<TAB>last" per
+line. It is written to PATH.tmp and renamed over PATH, so a job killed
+while writing leaves the previous checkpoint intact.
+
+Selection is any class with SaveAll(TFile*) and LoadAll(TFile*).
+*/
+
+struct EntryRange
+{
+    std::string file;
+    Long64_t first;
+    Long64_t last;
+};
+
+template <class Selection>
+bool write_checkpoint(TString path, Selection &selection, const std::vector<EntryRange> &done)
+{
+    TString tmppath = path + ".tmp";
+    TFile *outfile = new TFile(tmppath, "RECREATE");
+    if (outfile->IsZombie())
+    {
+        delete outfile;
+        return false;
+    }
+    selection.SaveAll(outfile);
+
+    std::ostringstream ranges;
+    for (const auto &range : done) ranges << range.file << "\t" << range.first << "\t" << range.last << "\n";
+    TObjString ranges_string(ranges.str().c_str());
+    outfile->WriteTObject(&ranges_string, "checkpoint_ranges");
+    outfile->Close();
+    delete outfile;
+
+    return gSystem->Rename(tmppath, path) == 0;
+}
+
+// Adds the checkpointed histograms to selection, which should be empty
+template <class Selection>
+bool read_checkpoint(TString path, Selection &selection, std::vector<EntryRange> &done)
+{
+    if (gSystem->AccessPathName(path)) return false;
+    TFile *infile = TFile::Open(path);
+    if (infile == nullptr or infile->IsZombie())
+    {
+        delete infile;
+        return false;
+    }
+    TObjString *ranges_string = nullptr;
+    infile->GetObject("checkpoint_ranges", ranges_string);
+    if (ranges_string == nullptr)
+    {
+        delete infile;
+        return false;
+    }
+
+    selection.LoadAll(infile);
+    std::istringstream ranges(ranges_string->GetString().Data());
+    std::string line;
+    while (std::getline(ranges, line))
+    {
+        std::istringstream fields(line);
+        EntryRange range;
+        if (std::getline(fields, range.file, '\t') and fields >> range.first >> range.last) done.push_back(range);
+    }
+    infile->Close();
+    delete infile;
+    return true;
+}
+
+#endif
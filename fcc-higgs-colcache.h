@@ -0,0 +1,556 @@
+#ifndef fcc_higgs_colcache_h
+#define fcc_higgs_colcache_h
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <TMath.h>
+#include <TSystem.h>
+#include "fcc-higgs-zonemap.h"
+
+/*
+Column cache: the columns of the selection as plain uncompressed arrays in
+one file, meant to be mmap'ed and read in place.
+
+Layout (all integers little endian, as written by this machine):
+
+    ColumnCacheHeader
+    ColumnCacheColumn[ncolumns]    name, type, byte offset, element count
+    ColumnCacheSource[nsources]    provenance of the entries
+    column data, every column starting on a 64 byte boundary
+
+Per-object columns (Jet_PT, Muon_Eta, ...) hold the objects of all events
+back to back; the Long64_t column <collection>_offsets (entries + 1 values)
+says where the objects of each event start, so event i owns objects
+offsets[i] to offsets[i+1]. Per-event columns (MissingET_MET, Event_Number,
+Event_Weight) have one value per event; caches without Event_Weight read
+with a weight of 1. Each source records the input file with its size
+and mtime when the cache was made, and the range of cache entries that came
+from it, so a stale cache can be told apart from a current one. It also
+records the weight of the events of its input that are not in the cache
+(failing the veto of make-column-cache.cpp, or dropped by the skim the
+source is), so the cache normalises like its inputs. Version 1 caches
+lack it and are not read; make them again.
+
+Types are 'F' (Float_t), 'I' (Int_t), 'i' (UInt_t) and 'L' (Long64_t).
+The zone map (fcc-higgs-zonemap.h) is stored as further columns.
+*/
+
+const char COLUMN_CACHE_MAGIC[8] = {'F', 'C', 'C', 'C', 'O', 'L', '1', '\0'};
+const UInt_t COLUMN_CACHE_VERSION = 2;
+
+struct ColumnCacheHeader
+{
+    char magic[8];
+    UInt_t version;
+    UInt_t ncolumns;
+    UInt_t nsources;
+    UInt_t reserved;
+    Long64_t entries;
+};
+
+struct ColumnCacheColumn
+{
+    char name[48];
+    char type;
+    char reserved[7];
+    Long64_t offset;
+    Long64_t count;
+};
+
+struct ColumnCacheSource
+{
+    char path[488];
+    Long64_t first_entry;
+    Long64_t entries;
+    Long64_t size;
+    Long64_t mtime;
+    double dropped_weight;  // of the events of the input not in the cache
+};
+
+// Collections with an offsets column
+const std::vector<std::string> COLUMN_CACHE_COLLECTIONS = {"Jet", "Muon", "Electron"};
+
+// Objects a reader can hold per event: the array size for the fixed arrays
+// of the Delphes class and FlatEvent, unbounded for mapped columns
+template <class T, size_t N>
+Int_t column_capacity(const T (&)[N]) { return N; }
+template <class T>
+Int_t column_capacity(const T *) { return 2147483647; }
+
+/*
+Builds a column cache in memory, event by event, and writes it out in one
+go. Meant for skims: the whole cache has to fit in memory while writing.
+*/
+class ColumnCacheWriter
+{
+    public:
+        ColumnCacheWriter()
+        {
+            for (const auto &collection : COLUMN_CACHE_COLLECTIONS) offsets[collection].push_back(0);
+            // Every column is written, also when no event has such objects
+            for (const char *name : {"Jet_PT", "Jet_Eta", "Jet_Phi", "Jet_Mass", "Muon_PT", "Muon_Eta", "Muon_Phi",
+                                     "Electron_PT", "Electron_Eta", "Electron_Phi", "MissingET_MET", "MissingET_Phi",
+                                     "Event_Weight"}) floats[name];
+            for (const char *name : {"Jet_Charge", "Muon_Charge", "Electron_Charge"}) ints[name];
+            for (const char *name : {"Jet_BTag", "Jet_TauTag"}) uints[name];
+            longs["Event_Number"];
+        }
+
+        // Starts the entries of a new input file, whose own input had events
+        // of dropped_weight that it does not hold (a skim)
+        void AddSource(const std::string &path, double dropped_weight = 0)
+        {
+            ColumnCacheSource source;
+            memset(&source, 0, sizeof(source));
+            strncpy(source.path, path.c_str(), sizeof(source.path) - 1);
+            source.first_entry = entries;
+            source.dropped_weight = dropped_weight;
+            FileStat_t stat;
+            if (gSystem->GetPathInfo(path.c_str(), stat) == 0)
+            {
+                source.size = stat.fSize;
+                source.mtime = stat.fMtime;
+            }
+            sources.push_back(source);
+        }
+
+        // Appends the event currently loaded in a Delphes-like reader
+        template <class Event>
+        void Fill(Event *event)
+        {
+            int njet = TMath::Min(event->Jet_size, column_capacity(event->Jet_PT));
+            for (int i=0; i<njet; i++)
+            {
+                floats["Jet_PT"].push_back(event->Jet_PT[i]);
+                floats["Jet_Eta"].push_back(event->Jet_Eta[i]);
+                floats["Jet_Phi"].push_back(event->Jet_Phi[i]);
+                floats["Jet_Mass"].push_back(event->Jet_Mass[i]);
+                uints["Jet_BTag"].push_back(event->Jet_BTag[i]);
+                uints["Jet_TauTag"].push_back(event->Jet_TauTag[i]);
+                ints["Jet_Charge"].push_back(event->Jet_Charge[i]);
+            }
+            offsets["Jet"].push_back(offsets["Jet"].back() + njet);
+
+            int nmuon = TMath::Min(event->Muon_size, column_capacity(event->Muon_PT));
+            for (int i=0; i<nmuon; i++)
+            {
+                floats["Muon_PT"].push_back(event->Muon_PT[i]);
+                floats["Muon_Eta"].push_back(event->Muon_Eta[i]);
+                floats["Muon_Phi"].push_back(event->Muon_Phi[i]);
+                ints["Muon_Charge"].push_back(event->Muon_Charge[i]);
+            }
+            offsets["Muon"].push_back(offsets["Muon"].back() + nmuon);
+
+            int nelectron = TMath::Min(event->Electron_size, column_capacity(event->Electron_PT));
+            for (int i=0; i<nelectron; i++)
+            {
+                floats["Electron_PT"].push_back(event->Electron_PT[i]);
+                floats["Electron_Eta"].push_back(event->Electron_Eta[i]);
+                floats["Electron_Phi"].push_back(event->Electron_Phi[i]);
+                ints["Electron_Charge"].push_back(event->Electron_Charge[i]);
+            }
+            offsets["Electron"].push_back(offsets["Electron"].back() + nelectron);
+
+            floats["MissingET_MET"].push_back(event->MissingET_MET[0]);
+            floats["MissingET_Phi"].push_back(event->MissingET_Phi[0]);
+            longs["Event_Number"].push_back(event->Event_Number[0]);
+            floats["Event_Weight"].push_back(event->Event_Weight[0]);
+
+            if (zones.empty() or zones.back().last - zones.back().first == ZONE_ENTRIES)
+            {
+                zones.emplace_back();
+                zones.back().Start(entries);
+            }
+            zones.back().Add(event);
+
+            entries++;
+            if (!sources.empty()) sources.back().entries++;
+        }
+
+        // Counts an event of the current source left out of the cache
+        void Drop(double weight)
+        {
+            if (!sources.empty()) sources.back().dropped_weight += weight;
+        }
+
+        Long64_t Entries() const { return entries; }
+
+        // Written to PATH.tmp and renamed, so readers never see half a file
+        bool Write(TString path)
+        {
+            std::vector<ColumnCacheColumn> columns;
+            std::vector<const void *> data;
+            auto add = [&](const std::string &name, char type, const void *values, Long64_t count)
+            {
+                ColumnCacheColumn column;
+                memset(&column, 0, sizeof(column));
+                strncpy(column.name, name.c_str(), sizeof(column.name) - 1);
+                column.type = type;
+                column.count = count;
+                columns.push_back(column);
+                data.push_back(values);
+            };
+            for (const auto &collection : COLUMN_CACHE_COLLECTIONS)
+            {
+                add(collection + "_offsets", 'L', offsets[collection].data(), offsets[collection].size());
+            }
+            for (const auto &entry : floats) add(entry.first, 'F', entry.second.data(), entry.second.size());
+            for (const auto &entry : ints) add(entry.first, 'I', entry.second.data(), entry.second.size());
+            for (const auto &entry : uints) add(entry.first, 'i', entry.second.data(), entry.second.size());
+            for (const auto &entry : longs) add(entry.first, 'L', entry.second.data(), entry.second.size());
+
+            std::vector<Long64_t> zone_first, zone_last;
+            std::vector<std::vector<Float_t>> zone_min(ZONE_NKEYS), zone_max(ZONE_NKEYS);
+            for (const auto &zone : zones)
+            {
+                zone_first.push_back(zone.first);
+                zone_last.push_back(zone.last);
+                for (int k=0; k<ZONE_NKEYS; k++)
+                {
+                    zone_min[k].push_back(zone.min[k]);
+                    zone_max[k].push_back(zone.max[k]);
+                }
+            }
+            add("zone_first", 'L', zone_first.data(), zone_first.size());
+            add("zone_last", 'L', zone_last.data(), zone_last.size());
+            for (int k=0; k<ZONE_NKEYS; k++)
+            {
+                add(std::string("zone_min_") + ZONE_KEY_NAMES[k], 'F', zone_min[k].data(), zone_min[k].size());
+                add(std::string("zone_max_") + ZONE_KEY_NAMES[k], 'F', zone_max[k].data(), zone_max[k].size());
+            }
+
+            ColumnCacheHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, COLUMN_CACHE_MAGIC, sizeof(header.magic));
+            header.version = COLUMN_CACHE_VERSION;
+            header.ncolumns = columns.size();
+            header.nsources = sources.size();
+            header.entries = entries;
+
+            Long64_t position = sizeof(header) + columns.size() * sizeof(ColumnCacheColumn) + sources.size() * sizeof(ColumnCacheSource);
+            for (auto &column : columns)
+            {
+                position = Align(position);
+                column.offset = position;
+                position += column.count * TypeSize(column.type);
+            }
+
+            TString tmppath = path + ".tmp";
+            FILE *out = fopen(tmppath.Data(), "wb");
+            if (out == nullptr) return false;
+            bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+            ok = ok and fwrite(columns.data(), sizeof(ColumnCacheColumn), columns.size(), out) == columns.size();
+            ok = ok and fwrite(sources.data(), sizeof(ColumnCacheSource), sources.size(), out) == sources.size();
+            static const char zeros[64] = {0};
+            for (size_t c=0; c<columns.size() and ok; c++)
+            {
+                Long64_t padding = columns[c].offset - ftell(out);
+                ok = fwrite(zeros, 1, padding, out) == (size_t) padding;
+                size_t bytes = columns[c].count * TypeSize(columns[c].type);
+                ok = ok and fwrite(data[c], 1, bytes, out) == bytes;
+            }
+            ok = fclose(out) == 0 and ok;
+            return ok and gSystem->Rename(tmppath, path) == 0;
+        }
+
+        static Long64_t Align(Long64_t position) { return (position + 63) / 64 * 64; }
+
+        static size_t TypeSize(char type)
+        {
+            return type == 'L' ? sizeof(Long64_t) : 4;
+        }
+
+    private:
+        Long64_t entries = 0;
+        std::vector<ColumnCacheSource> sources;
+        std::vector<Zone> zones;
+        std::map<std::string, std::vector<Long64_t>> offsets;
+        std::map<std::string, std::vector<Float_t>> floats;
+        std::map<std::string, std::vector<Int_t>> ints;
+        std::map<std::string, std::vector<UInt_t>> uints;
+        std::map<std::string, std::vector<Long64_t>> longs;
+};
+
+/*
+Read-only mapping of a column cache. Column() returns pointers straight
+into the mapping; nothing is copied or decoded.
+*/
+class MappedColumns
+{
+    public:
+        MappedColumns(const std::string &path)
+        {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) return;
+            struct stat st;
+            if (fstat(fd, &st) == 0 and st.st_size >= (off_t) sizeof(ColumnCacheHeader))
+            {
+                void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                if (mapping != MAP_FAILED)
+                {
+                    base = (const char *) mapping;
+                    length = st.st_size;
+                    madvise(mapping, length, MADV_SEQUENTIAL);
+                }
+            }
+            close(fd);
+            if (base == nullptr) return;
+
+            header = (const ColumnCacheHeader *) base;
+            Long64_t tables = sizeof(ColumnCacheHeader) + header->ncolumns * sizeof(ColumnCacheColumn) + header->nsources * sizeof(ColumnCacheSource);
+            if (memcmp(header->magic, COLUMN_CACHE_MAGIC, sizeof(COLUMN_CACHE_MAGIC)) != 0 or header->version != COLUMN_CACHE_VERSION or tables > length)
+            {
+                Unmap();
+                return;
+            }
+            columns = (const ColumnCacheColumn *) (base + sizeof(ColumnCacheHeader));
+            sources = (const ColumnCacheSource *) (columns + header->ncolumns);
+            for (UInt_t c=0; c<header->ncolumns; c++)
+            {
+                if (columns[c].offset + columns[c].count * ColumnCacheWriter::TypeSize(columns[c].type) > length)
+                {
+                    Unmap();
+                    return;
+                }
+            }
+        }
+        MappedColumns(const MappedColumns &) = delete;
+        ~MappedColumns() { Unmap(); }
+
+        bool IsValid() const { return base != nullptr; }
+        Long64_t Entries() const { return IsValid() ? header->entries : 0; }
+        UInt_t NSources() const { return IsValid() ? header->nsources : 0; }
+        const ColumnCacheSource &Source(UInt_t i) const { return sources[i]; }
+
+        template <class T>
+        const T *Column(const std::string &name, char type) const
+        {
+            const ColumnCacheColumn *column = Find(name, type);
+            return column == nullptr ? nullptr : (const T *) (base + column->offset);
+        }
+
+        // Number of values in a column, 0 if there is no such column
+        Long64_t Count(const std::string &name, char type) const
+        {
+            const ColumnCacheColumn *column = Find(name, type);
+            return column == nullptr ? 0 : column->count;
+        }
+
+        // Sources whose file changed (or went away) since the cache was made
+        std::vector<std::string> StaleSources() const
+        {
+            std::vector<std::string> stale;
+            for (UInt_t i=0; i<NSources(); i++)
+            {
+                FileStat_t stat;
+                if (gSystem->GetPathInfo(sources[i].path, stat) != 0 or stat.fSize != sources[i].size or stat.fMtime != sources[i].mtime)
+                {
+                    stale.push_back(sources[i].path);
+                }
+            }
+            return stale;
+        }
+
+    private:
+        const ColumnCacheColumn *Find(const std::string &name, char type) const
+        {
+            for (UInt_t c=0; IsValid() and c<header->ncolumns; c++)
+            {
+                if (name == columns[c].name and columns[c].type == type) return &columns[c];
+            }
+            return nullptr;
+        }
+
+        void Unmap()
+        {
+            if (base != nullptr) munmap((void *) base, length);
+            base = nullptr;
+        }
+
+        const char *base = nullptr;
+        Long64_t length = 0;
+        const ColumnCacheHeader *header = nullptr;
+        const ColumnCacheColumn *columns = nullptr;
+        const ColumnCacheSource *sources = nullptr;
+};
+
+/*
+Event view over a MappedColumns with the member names of the Delphes class,
+for the selection code. GetEntry() only moves the pointers to the objects
+of that entry; the values are read from the mapping when used.
+*/
+class MappedEvent
+{
+    public:
+        Int_t Jet_size = 0;
+        const Float_t *Jet_PT = nullptr;
+        const Float_t *Jet_Eta = nullptr;
+        const Float_t *Jet_Phi = nullptr;
+        const Float_t *Jet_Mass = nullptr;
+        const UInt_t *Jet_BTag = nullptr;
+        const UInt_t *Jet_TauTag = nullptr;
+        const Int_t *Jet_Charge = nullptr;
+
+        Int_t Muon_size = 0;
+        const Float_t *Muon_PT = nullptr;
+        const Float_t *Muon_Eta = nullptr;
+        const Float_t *Muon_Phi = nullptr;
+        const Int_t *Muon_Charge = nullptr;
+
+        Int_t Electron_size = 0;
+        const Float_t *Electron_PT = nullptr;
+        const Float_t *Electron_Eta = nullptr;
+        const Float_t *Electron_Phi = nullptr;
+        const Int_t *Electron_Charge = nullptr;
+
+        Int_t MissingET_size = 1;
+        const Float_t *MissingET_MET = nullptr;
+        const Float_t *MissingET_Phi = nullptr;
+        const Long64_t *Event_Number = nullptr;
+        const Float_t *Event_Weight = nullptr;
+
+        MappedEvent(const std::string &path) : columns(path)
+        {
+            if (!columns.IsValid()) return;
+            jet_offsets = columns.Column<Long64_t>("Jet_offsets", 'L');
+            muon_offsets = columns.Column<Long64_t>("Muon_offsets", 'L');
+            electron_offsets = columns.Column<Long64_t>("Electron_offsets", 'L');
+            jet_pt = columns.Column<Float_t>("Jet_PT", 'F');
+            jet_eta = columns.Column<Float_t>("Jet_Eta", 'F');
+            jet_phi = columns.Column<Float_t>("Jet_Phi", 'F');
+            jet_mass = columns.Column<Float_t>("Jet_Mass", 'F');
+            jet_btag = columns.Column<UInt_t>("Jet_BTag", 'i');
+            jet_tautag = columns.Column<UInt_t>("Jet_TauTag", 'i');
+            jet_charge = columns.Column<Int_t>("Jet_Charge", 'I');
+            muon_pt = columns.Column<Float_t>("Muon_PT", 'F');
+            muon_eta = columns.Column<Float_t>("Muon_Eta", 'F');
+            muon_phi = columns.Column<Float_t>("Muon_Phi", 'F');
+            muon_charge = columns.Column<Int_t>("Muon_Charge", 'I');
+            electron_pt = columns.Column<Float_t>("Electron_PT", 'F');
+            electron_eta = columns.Column<Float_t>("Electron_Eta", 'F');
+            electron_phi = columns.Column<Float_t>("Electron_Phi", 'F');
+            electron_charge = columns.Column<Int_t>("Electron_Charge", 'I');
+            met = columns.Column<Float_t>("MissingET_MET", 'F');
+            met_phi = columns.Column<Float_t>("MissingET_Phi", 'F');
+            event_number = columns.Column<Long64_t>("Event_Number", 'L');
+            event_weight = columns.Column<Float_t>("Event_Weight", 'F');
+        }
+
+        // False for a file that is not a column cache, or lacks a column
+        bool IsValid() const
+        {
+            return columns.IsValid() and jet_offsets and muon_offsets and electron_offsets and jet_pt and jet_eta and jet_phi
+                   and jet_mass and jet_btag and jet_tautag and jet_charge and muon_pt and muon_eta and muon_phi and muon_charge
+                   and electron_pt and electron_eta and electron_phi and electron_charge and met and met_phi and event_number;
+        }
+
+        const MappedColumns &Columns() const { return columns; }
+        Long64_t GetEntries() const { return columns.Entries(); }
+
+        Int_t GetEntry(Long64_t entry)
+        {
+            Long64_t jet = jet_offsets[entry];
+            Jet_size = jet_offsets[entry + 1] - jet;
+            Jet_PT = jet_pt + jet;
+            Jet_Eta = jet_eta + jet;
+            Jet_Phi = jet_phi + jet;
+            Jet_Mass = jet_mass + jet;
+            Jet_BTag = jet_btag + jet;
+            Jet_TauTag = jet_tautag + jet;
+            Jet_Charge = jet_charge + jet;
+
+            Long64_t muon = muon_offsets[entry];
+            Muon_size = muon_offsets[entry + 1] - muon;
+            Muon_PT = muon_pt + muon;
+            Muon_Eta = muon_eta + muon;
+            Muon_Phi = muon_phi + muon;
+            Muon_Charge = muon_charge + muon;
+
+            Long64_t electron = electron_offsets[entry];
+            Electron_size = electron_offsets[entry + 1] - electron;
+            Electron_PT = electron_pt + electron;
+            Electron_Eta = electron_eta + electron;
+            Electron_Phi = electron_phi + electron;
+            Electron_Charge = electron_charge + electron;
+
+            MissingET_MET = met + entry;
+            MissingET_Phi = met_phi + entry;
+            Event_Number = event_number + entry;
+            Event_Weight = event_weight == nullptr ? &unit_weight : event_weight + entry;
+            return 1;
+        }
+
+    private:
+        MappedColumns columns;
+        const Long64_t *jet_offsets = nullptr;
+        const Long64_t *muon_offsets = nullptr;
+        const Long64_t *electron_offsets = nullptr;
+        const Float_t *jet_pt = nullptr;
+        const Float_t *jet_eta = nullptr;
+        const Float_t *jet_phi = nullptr;
+        const Float_t *jet_mass = nullptr;
+        const UInt_t *jet_btag = nullptr;
+        const UInt_t *jet_tautag = nullptr;
+        const Int_t *jet_charge = nullptr;
+        const Float_t *muon_pt = nullptr;
+        const Float_t *muon_eta = nullptr;
+        const Float_t *muon_phi = nullptr;
+        const Int_t *muon_charge = nullptr;
+        const Float_t *electron_pt = nullptr;
+        const Float_t *electron_eta = nullptr;
+        const Float_t *electron_phi = nullptr;
+        const Int_t *electron_charge = nullptr;
+        const Float_t *met = nullptr;
+        const Float_t *met_phi = nullptr;
+        const Long64_t *event_number = nullptr;
+        const Float_t *event_weight = nullptr;  // optional
+        const Float_t unit_weight = 1;
+};
+
+// Returns false if the cache has no zone map
+bool read_zone_map(const MappedColumns &columns, std::vector<Zone> &zones)
+{
+    const Long64_t *first = columns.Column<Long64_t>("zone_first", 'L');
+    const Long64_t *last = columns.Column<Long64_t>("zone_last", 'L');
+    if (first == nullptr or last == nullptr) return false;
+    std::vector<const Float_t *> min(ZONE_NKEYS), max(ZONE_NKEYS);
+    for (int k=0; k<ZONE_NKEYS; k++)
+    {
+        min[k] = columns.Column<Float_t>(std::string("zone_min_") + ZONE_KEY_NAMES[k], 'F');
+        max[k] = columns.Column<Float_t>(std::string("zone_max_") + ZONE_KEY_NAMES[k], 'F');
+        if (min[k] == nullptr or max[k] == nullptr) return false;
+    }
+    for (Long64_t z=0; z<columns.Count("zone_first", 'L'); z++)
+    {
+        Zone zone;
+        zone.first = first[z];
+        zone.last = last[z];
+        for (int k=0; k<ZONE_NKEYS; k++)
+        {
+            zone.min[k] = min[k][z];
+            zone.max[k] = max[k][z];
+        }
+        zones.push_back(zone);
+    }
+    return true;
+}
+
+// True if filename starts with the column cache magic
+bool is_column_cache(const std::string &filename)
+{
+    char magic[sizeof(COLUMN_CACHE_MAGIC)] = {0};
+    FILE *in = fopen(filename.c_str(), "rb");
+    if (in == nullptr) return false;
+    bool ok = fread(magic, 1, sizeof(magic), in) == sizeof(magic);
+    fclose(in);
+    return ok and memcmp(magic, COLUMN_CACHE_MAGIC, sizeof(magic)) == 0;
+}
+
+#endif
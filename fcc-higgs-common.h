@@ -0,0 +1,228 @@
+#ifndef fcc_higgs_common_h
+#define fcc_higgs_common_h
+
+#include <glob.h>
+#include <string>
+#include <vector>
+#include "Delphes.C"
+#include <TDirectory.h>
+#include <TH1D.h>
+#include <TLorentzVector.h>
+#include <TMath.h>
+#include "fcc-higgs-bootstrap.h"
+
+using namespace std;
+
+/*
+Helpers shared by the v2 and v3 selections: input globbing, the lepton
+searches, the histogram set, and the per-event object stage that both
+selections read, so that running them together reads and prepares every
+event once.
+*/
+
+std::vector<std::string> glob(const char *pattern) {
+    glob_t g;
+    glob(pattern, GLOB_TILDE, nullptr, &g); // one should ensure glob returns 0!
+    std::vector<std::string> filelist;
+    filelist.reserve(g.gl_pathc);
+    for (size_t i = 0; i < g.gl_pathc; ++i) {
+        filelist.emplace_back(g.gl_pathv[i]);
+    }
+    globfree(&g);
+    return filelist;
+}
+
+Float_t deltaPhi(Float_t phi1, Float_t phi2)
+{
+    Float_t dphi = phi1 - phi2;
+    while (dphi >  TMath::Pi()) dphi -= 2*TMath::Pi();
+    while (dphi < -TMath::Pi()) dphi += 2*TMath::Pi();
+    return TMath::Abs(dphi);
+}
+
+
+// With a muon_index, the electron must be away from that muon and of
+// opposite charge, or of the same charge with same_charge
+template <class Event>
+vector<int> find_ele(Event *indelphes, double ptcut, int muon_index, bool same_charge = false)
+{
+    vector<int> res;
+    for (int e=0; e<indelphes->Electron_size; e++)
+    {
+        if (indelphes->Electron_PT[e] < ptcut) continue;
+        if (TMath::Abs(indelphes->Electron_Eta[e]) > 6.0) continue;
+        //if (TMath::Abs(indelphes->Electron_Eta[e]) > 1.44 && TMath::Abs(indelphes->Electron_Eta[e]) < 1.57) continue;
+        //if (indelphes->Electron_IsolationVar[e] < 0.1) continue;
+        if (muon_index != -1)
+        {
+            double deltaR = 0;
+            deltaR += TMath::Power((indelphes->Electron_Eta[e] - indelphes->Muon_Eta[muon_index]), 2);
+            deltaR += TMath::Power((indelphes->Electron_Phi[e] - indelphes->Muon_Phi[muon_index]), 2);
+            deltaR = TMath::Sqrt(deltaR);
+            if (deltaR < 0.3) continue;
+            if ((indelphes->Electron_Charge[e] == indelphes->Muon_Charge[muon_index]) != same_charge) continue;
+        }
+        res.push_back(e);
+    }
+    return res;
+}
+
+template <class Event>
+vector<int> find_mu(Event *indelphes, double ptcut, int electron_index, bool same_charge = false)
+{
+    vector<int> res;
+    for (int mu=0; mu<indelphes->Muon_size; mu++)
+    {
+        if (indelphes->Muon_PT[mu] < ptcut) continue;
+        if (TMath::Abs(indelphes->Muon_Eta[mu]) > 6.0) continue;
+        //if (indelphes->Muon_IsolationVar[mu] > 0.15) continue;
+
+        if (electron_index != -1)
+        {
+            double deltaR = 0;
+            deltaR += TMath::Power((indelphes->Muon_Eta[mu] - indelphes->Electron_Eta[electron_index]), 2);
+            deltaR += TMath::Power((indelphes->Muon_Phi[mu] - indelphes->Electron_Phi[electron_index]), 2);
+            deltaR = TMath::Sqrt(deltaR);
+            if (deltaR < 0.3) continue;
+            if ((indelphes->Muon_Charge[mu] == indelphes->Electron_Charge[electron_index]) != same_charge) continue;
+        }
+        res.push_back(mu);
+    }
+    return res;
+}
+
+class PlotSet
+{
+    public:
+        PlotSet() { }
+        PlotSet(const PlotSet &) = delete;
+        ~PlotSet()
+        {
+            delete replicas;
+        }
+        int AddHist(TH1D* hist)
+        {
+            // Sum of squared weights per bin, for weighted fills
+            hist->Sumw2();
+            histograms.push_back(hist);
+            return histograms.size() - 1;
+        }
+        void SaveAll(TDirectory *outfile)
+        {
+            outfile->cd();
+            for (TH1* hist: histograms) hist->Write();
+            if (replicas != nullptr) replicas->Save(outfile, histograms);
+        }
+        void ResetAll()
+        {
+            for (TH1* hist: histograms) hist->Reset();
+            if (replicas != nullptr) replicas->Reset();
+        }
+        void ScaleAll(double factor)
+        {
+            for (TH1* hist: histograms) hist->Scale(factor);
+            if (replicas != nullptr) replicas->Scale(factor);
+        }
+        void AddAll(const PlotSet &other)
+        {
+            for (size_t i=0; i<histograms.size() and i<other.histograms.size(); i++) histograms[i]->Add(other.histograms[i]);
+            if (replicas != nullptr and other.replicas != nullptr) replicas->Add(*other.replicas);
+        }
+        void LoadAll(TDirectory *infile)
+        {
+            for (TH1* hist: histograms)
+            {
+                TH1 *stored = nullptr;
+                infile->GetObject(hist->GetName(), stored);
+                if (stored) hist->Add(stored);
+            }
+            if (replicas != nullptr) replicas->Load(infile, histograms);
+        }
+        void PrimeFill(double *value)
+        {
+            primed_variable = value;
+        }
+        // Weight of every fill, 1 if never primed
+        void PrimeWeight(double *weight)
+        {
+            primed_weight = weight;
+        }
+        // Bootstrap replicas of all histograms (fcc-higgs-bootstrap.h), filled
+        // with the current weights; call once all histograms are added
+        void EnableBootstrap(const BootstrapWeights *weights)
+        {
+            delete replicas;
+            replicas = new BootstrapReplicas(histograms, weights);
+        }
+        void Fill(int histnum)
+        {
+            if (histnum >= histograms.size()) return;
+            double weight = primed_weight == nullptr ? 1 : *primed_weight;
+            int bin = histograms[histnum]->Fill(*primed_variable, weight);
+            if (replicas != nullptr and bin >= 0) replicas->Fill(histnum, bin, weight);
+        }
+        vector<TH1*> histograms;
+
+    private:
+        double *primed_variable;
+        double *primed_weight = nullptr;
+        BootstrapReplicas *replicas = nullptr;
+};
+
+/*
+Objects of one event that do not depend on the selection: the jets
+(pT > 30 GeV, |eta| < 6) and the b-tagged ones among them, and the
+lepton pair the collinear mass falls back to when a channel has not
+selected one (the first muon and electron, the one closer to the MET
+taken as the tau). Fill() only does the work on its first call after
+Clear(), so selections that reject the event early never pay for it.
+*/
+struct EventObjects
+{
+    vector<int> jets;
+    vector<int> b_jets;
+    TLorentzVector fallback_tau;
+    TLorentzVector fallback_lepton;
+
+    bool filled = false;
+
+    void Clear()
+    {
+        filled = false;
+    }
+
+    template <class Event>
+    void Fill(Event *indelphes)
+    {
+        if (filled) return;
+        filled = true;
+        jets.clear();
+        b_jets.clear();
+        for (int j=0; j<indelphes->Jet_size; j++)
+        {
+            if (indelphes->Jet_PT[j] < 30) continue;
+            if (TMath::Abs(indelphes->Jet_Eta[j]) > 6.0) continue;
+            jets.push_back(j);
+            if (indelphes->Jet_BTag[j] & 0b111) b_jets.push_back(j);
+        }
+
+        TLorentzVector p4_muon, p4_electron, p4_met;
+        if (indelphes->Muon_size > 0) p4_muon.SetPtEtaPhiM(indelphes->Muon_PT[0], indelphes->Muon_Eta[0], indelphes->Muon_Phi[0], 0.10566);
+        else p4_muon.SetPtEtaPhiM(0, 0, 0, 0.10566);
+        if (indelphes->Electron_size > 0) p4_electron.SetPtEtaPhiM(indelphes->Electron_PT[0], indelphes->Electron_Eta[0], indelphes->Electron_Phi[0], 0.000511);
+        else p4_electron.SetPtEtaPhiM(0, 0, 0, 0.000511);
+        p4_met.SetPtEtaPhiM(indelphes->MissingET_MET[0], 0, indelphes->MissingET_Phi[0], 0);
+        if (p4_muon.DeltaR(p4_met) < p4_electron.DeltaR(p4_met))
+        {
+            fallback_tau.SetPtEtaPhiM(p4_muon.Pt(), p4_muon.Eta(), p4_muon.Phi(), 0.10566);
+            fallback_lepton.SetPtEtaPhiM(p4_electron.Pt(), p4_electron.Eta(), p4_electron.Phi(), 0.000511);
+        }
+        else
+        {
+            fallback_lepton.SetPtEtaPhiM(p4_muon.Pt(), p4_muon.Eta(), p4_muon.Phi(), 0.10566);
+            fallback_tau.SetPtEtaPhiM(p4_electron.Pt(), p4_electron.Eta(), p4_electron.Phi(), 0.000511);
+        }
+    }
+};
+
+#endif
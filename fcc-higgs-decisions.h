@@ -0,0 +1,159 @@
+#ifndef fcc_higgs_decisions_h
+#define fcc_higgs_decisions_h
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <TFile.h>
+#include <TList.h>
+#include <TObjString.h>
+#include <TSystem.h>
+#include <TTree.h>
+
+/*
+Per-event decision bits of the v3 selection.
+
+With the option decisions, run_fcc_higgs writes OUTPUT.decisions.root with
+one entry of the tree "decisions" per event passing the lepton veto:
+    file      index into the list "decision_files" of input files
+    entry     entry of the event in that file
+    number    Event.Number
+    njet      selected jets (pT > 30 GeV, |eta| < 6)
+    steps[2]  cut flow of mutau_e and etau_mu: bit k is set if the event
+              entered the k-th histogram of the channel, in booking order
+              (step00..02, then per jet bin step03..10, highmass, lowmass),
+              e.g. mutau_e_step07_1j is bit 3 + 10*1 + 4
+    cuts[2]   every cut of the channel on its own (CUT_* below), for N-1
+              distributions
+Events failing the veto have no entry, all their bits are zero. Entries
+are sorted by file and entry, so any subset of them reads its inputs front
+to back. replot-fcc-higgs.cpp fills histograms from such a sidecar.
+*/
+
+const char *DECISION_TREE_NAME = "decisions";
+const char *DECISION_FILES_NAME = "decision_files";
+enum DecisionChannel { DECISION_MUTAUE, DECISION_ETAUMU, DECISION_NCHANNELS };
+const char *DECISION_CHANNEL_NAMES[DECISION_NCHANNELS] = {"mutau_e", "etau_mu"};
+
+/*
+The cuts, "leading" being the muon of mutau_e (pT > 53 GeV) and the
+electron of etau_mu (pT > 26 GeV), "tau" the other lepton (pT > 10 GeV).
+The kinematic cuts are only set for events with exactly one of each.
+*/
+enum CutBit {
+    CUT_NO_BJET,     // no b-tagged jet
+    CUT_MAX_JETS,    // at most MAX_JETS jets
+    CUT_LEAD_FOUND,  // 1+ leading lepton
+    CUT_LEAD_ONE,    // exactly one leading lepton
+    CUT_TAU_FOUND,   // 1+ tau lepton
+    CUT_TAU_ONE,     // exactly one tau lepton
+    CUT_LEAD_PT,     // leading lepton pT > 60 GeV
+    CUT_DPHI_MET,    // deltaPhi(tau lepton, MET) < 0.7
+    CUT_DPHI_EMU,    // deltaPhi(e, mu) > 2.2
+    CUT_HIGHMASS,    // leading lepton pT > 150 GeV and deltaPhi(tau lepton, MET) < 0.3
+    CUT_NBITS
+};
+const char *CUT_NAMES[CUT_NBITS] = {"no_bjet", "max_jets", "lead_found", "lead_one", "tau_found", "tau_one",
+                                    "lead_pt", "dphi_met", "dphi_emu", "highmass"};
+// All cuts of the low mass and high mass categories
+const ULong64_t CUTS_LOWMASS = (1ULL << CUT_HIGHMASS) - 1;
+const ULong64_t CUTS_HIGHMASS = (1ULL << CUT_NBITS) - 1;
+
+struct DecisionRecord
+{
+    Int_t file = 0;
+    Long64_t entry = 0;
+    Long64_t number = 0;
+    Int_t njet = 0;
+    ULong64_t steps[DECISION_NCHANNELS];
+    ULong64_t cuts[DECISION_NCHANNELS];
+
+    bool operator<(const DecisionRecord &other) const
+    {
+        return file != other.file ? file < other.file : entry < other.entry;
+    }
+};
+
+// Returns the CutBit of name, -1 if unknown
+int cut_bit(const std::string &name)
+{
+    for (int c=0; c<CUT_NBITS; c++) if (name == CUT_NAMES[c]) return c;
+    return -1;
+}
+
+// Sorts records and writes them, atomically replacing path
+bool write_decisions(const TString &path, const std::vector<std::string> &files, std::vector<DecisionRecord> &records)
+{
+    std::sort(records.begin(), records.end());
+    TString tmp = path + ".tmp";
+    TFile *outfile = new TFile(tmp, "RECREATE");
+    if (outfile->IsZombie())
+    {
+        delete outfile;
+        return false;
+    }
+    TList names;
+    names.SetOwner();
+    for (const auto &filename : files) names.Add(new TObjString(filename.c_str()));
+    names.Write(DECISION_FILES_NAME, TObject::kSingleKey);
+
+    DecisionRecord record;
+    TTree *tree = new TTree(DECISION_TREE_NAME, "per-event decision bits of the v3 selection");
+    tree->Branch("file", &record.file, "file/I");
+    tree->Branch("entry", &record.entry, "entry/L");
+    tree->Branch("number", &record.number, "number/L");
+    tree->Branch("njet", &record.njet, "njet/I");
+    tree->Branch("steps", record.steps, Form("steps[%d]/l", DECISION_NCHANNELS));
+    tree->Branch("cuts", record.cuts, Form("cuts[%d]/l", DECISION_NCHANNELS));
+    for (const auto &r : records)
+    {
+        record = r;
+        tree->Fill();
+    }
+    tree->Write();
+    outfile->Close();
+    delete outfile;
+    return gSystem->Rename(tmp, path) == 0;
+}
+
+// Returns false if path is not a decisions file
+bool read_decisions(const TString &path, std::vector<std::string> &files, std::vector<DecisionRecord> &records)
+{
+    TFile *infile = TFile::Open(path);
+    if (infile == nullptr or infile->IsZombie())
+    {
+        delete infile;
+        return false;
+    }
+    TList *names = nullptr;
+    TTree *tree = nullptr;
+    infile->GetObject(DECISION_FILES_NAME, names);
+    infile->GetObject(DECISION_TREE_NAME, tree);
+    if (names == nullptr or tree == nullptr)
+    {
+        delete infile;
+        return false;
+    }
+    for (int i=0; i<names->GetEntries(); i++) files.push_back(((TObjString *) names->At(i))->GetString().Data());
+    names->SetOwner();
+    delete names;
+
+    DecisionRecord record;
+    tree->SetBranchAddress("file", &record.file);
+    tree->SetBranchAddress("entry", &record.entry);
+    tree->SetBranchAddress("number", &record.number);
+    tree->SetBranchAddress("njet", &record.njet);
+    tree->SetBranchAddress("steps", record.steps);
+    tree->SetBranchAddress("cuts", record.cuts);
+    records.reserve(tree->GetEntries());
+    for (Long64_t i=0; i<tree->GetEntries(); i++)
+    {
+        tree->GetEntry(i);
+        records.push_back(record);
+    }
+    delete infile;
+    return true;
+}
+
+#endif
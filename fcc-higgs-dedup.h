@@ -0,0 +1,151 @@
+#ifndef fcc_higgs_dedup_h
+#define fcc_higgs_dedup_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "fcc-higgs-bootstrap.h"
+
+/*
+Rejection of events read twice, e.g. when a gridpack seed was rerun after
+a failure and both outputs ended up in the inputs of a process.
+
+An event is keyed on (sample, source, Event.Number). The source is the
+production of its file, the directory holding it (e.g. hvqMulti1M and
+hvqMulti10M of ttbar_hvq), and the seed within that production, the last
+number of the file name (events_SEED.root, delphes_output_SEED.root) or,
+for a file name without one, of the directory (mg5_SEED/events.root, the
+production then being the directory above). A file without any seed is
+a source of its own, keyed on its path. So only a seed read twice within one production
+collides; productions started from the same seeds do not. The 64 bit key
+goes to a hash set shared by all threads while the events are read, and
+an event whose key is already there, read from another file or entry, is
+dropped before the selection. On resume, the Event.Number of the ranges
+restored from the checkpoint are read into the set again first.
+
+The set is split into shards by the top bits of the key, each an open
+addressing table of (key, file and entry) behind its own mutex, so the
+threads rarely wait on each other; it takes 25 to 45 bytes per event. The
+file and entry of the first read make a second copy of the same chunk
+(speculation, fcc-higgs-scheduler.h) pass, as it is not a duplicate. Two
+different events share a key with probability n^2 / 2^65, below 1e-5 for
+20 million events.
+*/
+
+const int DEDUP_SHARD_BITS = 6;
+
+// Last number in name, -1 if it has none
+inline Long64_t last_number(const std::string &name)
+{
+    size_t end = name.find_last_of("0123456789");
+    if (end == std::string::npos) return -1;
+    size_t start = name.find_last_not_of("0123456789", end);
+    start = start == std::string::npos ? 0 : start + 1;
+    return atoll(name.substr(start, end - start + 1).c_str());
+}
+
+// Splits path into its directory and its last component
+inline void split_path(const std::string &path, std::string &dir, std::string &name)
+{
+    size_t slash = path.rfind('/');
+    dir = slash == std::string::npos ? "" : path.substr(0, slash);
+    name = slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// FNV-1a, stable from run to run unlike std::hash
+inline ULong64_t string_hash(const std::string &text)
+{
+    ULong64_t hash = 0xCBF29CE484222325ULL;
+    for (unsigned char c : text) hash = (hash ^ c) * 0x100000001B3ULL;
+    return hash;
+}
+
+// Source of the events of a file: its production and its seed in there,
+// or else the file itself
+inline ULong64_t dedup_source(int sample, const std::string &filename)
+{
+    std::string production, name;
+    split_path(filename, production, name);
+    Long64_t seed = last_number(name);
+    if (seed < 0)
+    {
+        split_path(std::string(production), production, name);
+        seed = last_number(name);
+    }
+    if (seed < 0) return bootstrap_hash(sample, string_hash(filename));
+    return bootstrap_hash(bootstrap_hash(sample, string_hash(production)), seed);
+}
+
+// Key of event number of a file with source
+inline ULong64_t dedup_key(ULong64_t source, Long64_t number)
+{
+    return bootstrap_hash(source, number);
+}
+
+class DuplicateFilter
+{
+    public:
+        // True if the event with key was read before from another file or entry
+        bool Seen(ULong64_t key, int file, Long64_t entry)
+        {
+            if (key == 0) key = 1;  // 0 marks empty slots
+            ULong64_t owner = ((ULong64_t) file << 40) | entry;
+            Shard &shard = shards[key >> (64 - DEDUP_SHARD_BITS)];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (10 * (shard.size + 1) > 7 * shard.keys.size()) Grow(shard);
+            size_t mask = shard.keys.size() - 1;
+            for (size_t slot = key & mask; ; slot = (slot + 1) & mask)
+            {
+                if (shard.keys[slot] == key) return shard.owners[slot] != owner;
+                if (shard.keys[slot] != 0) continue;
+                shard.keys[slot] = key;
+                shard.owners[slot] = owner;
+                shard.size++;
+                return false;
+            }
+        }
+
+        Long64_t Size()
+        {
+            Long64_t size = 0;
+            for (Shard &shard : shards)
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                size += shard.size;
+            }
+            return size;
+        }
+
+    private:
+        struct Shard
+        {
+            std::mutex mutex;
+            std::vector<ULong64_t> keys;
+            std::vector<ULong64_t> owners;
+            size_t size = 0;
+        };
+
+        static void Grow(Shard &shard)
+        {
+            std::vector<ULong64_t> keys(std::max<size_t>(1024, 2 * shard.keys.size()), 0);
+            std::vector<ULong64_t> owners(keys.size(), 0);
+            size_t mask = keys.size() - 1;
+            for (size_t i=0; i<shard.keys.size(); i++)
+            {
+                if (shard.keys[i] == 0) continue;
+                size_t slot = shard.keys[i] & mask;
+                while (keys[slot] != 0) slot = (slot + 1) & mask;
+                keys[slot] = shard.keys[i];
+                owners[slot] = shard.owners[i];
+            }
+            shard.keys.swap(keys);
+            shard.owners.swap(owners);
+        }
+
+        Shard shards[1 << DEDUP_SHARD_BITS];
+};
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef fcc_higgs_eventindex_h
+#define fcc_higgs_eventindex_h
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <TFile.h>
+#include <TList.h>
+#include <TObjString.h>
+#include <TSystem.h>
+#include <TTree.h>
+#include "fcc-higgs-unbinned.h"
+
+/*
+Where events are: the input file and entry of the selected events of the
+final categories, and of every event of a dataset by Event.Number.
+
+With the option events, run_fcc_higgs writes OUTPUT.events.root, with the
+list "event_files" of input files and per final category a tree named
+after its histogram (mutau_e_highmass_1j, ...), one entry per event filled
+into it:
+    file      index into event_files
+    entry     entry of the event in that file
+    number    Event.Number
+    mass      collinear mass, as filled
+    weight    weight, as filled (unscaled)
+sorted by file and entry.
+
+index-fcc-higgs.cpp writes the same list and the tree "event_index" of
+(number, file, entry) of every event of a dataset, sorted by number, and
+find-event-fcc-higgs.cpp finds the entries of a number with a binary
+search over it: O(log n) entries of the index and one GetEntry of the
+input, instead of a scan of the whole dataset.
+*/
+
+const char *EVENT_FILES_NAME = "event_files";
+const char *EVENT_INDEX_NAME = "event_index";
+
+struct EventLocation
+{
+    Int_t file = 0;
+    Long64_t entry = 0;
+    Long64_t number = 0;
+    SelectedEvent selected = {0, 0, 0, 0, 0};
+
+    // Category first, so the events of a category are one block
+    bool operator<(const EventLocation &other) const
+    {
+        if (selected.channel != other.selected.channel) return selected.channel < other.selected.channel;
+        if (selected.highmass != other.selected.highmass) return selected.highmass < other.selected.highmass;
+        if (selected.njet != other.selected.njet) return selected.njet < other.selected.njet;
+        return file != other.file ? file < other.file : entry < other.entry;
+    }
+};
+
+void write_event_files(TDirectory *outfile, const std::vector<std::string> &files)
+{
+    outfile->cd();
+    TList names;
+    names.SetOwner();
+    for (const auto &filename : files) names.Add(new TObjString(filename.c_str()));
+    names.Write(EVENT_FILES_NAME, TObject::kSingleKey);
+}
+
+// Returns false if infile has no list of files
+bool read_event_files(TDirectory *infile, std::vector<std::string> &files)
+{
+    TList *names = nullptr;
+    infile->GetObject(EVENT_FILES_NAME, names);
+    if (names == nullptr) return false;
+    for (int i=0; i<names->GetEntries(); i++) files.push_back(((TObjString *) names->At(i))->GetString().Data());
+    names->SetOwner();
+    delete names;
+    return true;
+}
+
+// Writes path.tmp and renames it, so readers never see a partial file
+bool write_selected_locations(const TString &path, const std::vector<std::string> &files, std::vector<EventLocation> &locations)
+{
+    std::sort(locations.begin(), locations.end());
+    TString tmp = path + ".tmp";
+    TFile *outfile = new TFile(tmp, "RECREATE");
+    if (outfile->IsZombie())
+    {
+        delete outfile;
+        return false;
+    }
+    write_event_files(outfile, files);
+
+    EventLocation location;
+    TTree *tree = nullptr;
+    TString name;
+    for (const auto &l : locations)
+    {
+        TString category = selected_hist_name(l.selected.channel, l.selected.highmass, l.selected.njet);
+        if (tree == nullptr or category != name)
+        {
+            if (tree != nullptr) tree->Write();
+            delete tree;
+            name = category;
+            tree = new TTree(name, "file, entry and Event.Number of the selected events");
+            tree->Branch("file", &location.file, "file/I");
+            tree->Branch("entry", &location.entry, "entry/L");
+            tree->Branch("number", &location.number, "number/L");
+            tree->Branch("mass", &location.selected.mass, "mass/F");
+            tree->Branch("weight", &location.selected.weight, "weight/F");
+        }
+        location = l;
+        tree->Fill();
+    }
+    if (tree != nullptr) tree->Write();
+    delete tree;
+    outfile->Close();
+    delete outfile;
+    return gSystem->Rename(tmp, path) == 0;
+}
+
+// Sorted by number, then file and entry
+bool write_event_index(const TString &path, const std::vector<std::string> &files, std::vector<EventLocation> &locations)
+{
+    std::sort(locations.begin(), locations.end(), [](const EventLocation &a, const EventLocation &b)
+    {
+        if (a.number != b.number) return a.number < b.number;
+        return a.file != b.file ? a.file < b.file : a.entry < b.entry;
+    });
+    TString tmp = path + ".tmp";
+    TFile *outfile = new TFile(tmp, "RECREATE");
+    if (outfile->IsZombie())
+    {
+        delete outfile;
+        return false;
+    }
+    write_event_files(outfile, files);
+
+    EventLocation location;
+    TTree *tree = new TTree(EVENT_INDEX_NAME, "file and entry of every event, sorted by Event.Number");
+    tree->Branch("number", &location.number, "number/L");
+    tree->Branch("file", &location.file, "file/I");
+    tree->Branch("entry", &location.entry, "entry/L");
+    for (const auto &l : locations)
+    {
+        location = l;
+        tree->Fill();
+    }
+    tree->Write();
+    outfile->Close();
+    delete outfile;
+    return gSystem->Rename(tmp, path) == 0;
+}
+
+#endif
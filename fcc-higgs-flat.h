@@ -0,0 +1,199 @@
+#ifndef fcc_higgs_flat_h
+#define fcc_higgs_flat_h
+
+#include <string>
+#include <vector>
+#include <TFile.h>
+#include <TTree.h>
+#include <TBranch.h>
+
+/*
+Flat skim layout.
+
+A flat skim is a tree "Events" with one plain branch per column the
+selection reads, no TClonesArray, no fUniqueID/fBits side branches:
+
+    Jet_size/I       Jet_PT[Jet_size]/F  Jet_Eta  Jet_Phi  Jet_Mass
+                     Jet_BTag[Jet_size]/i  Jet_TauTag  Jet_Charge/I
+    Muon_size/I      Muon_PT[Muon_size]/F  Muon_Eta  Muon_Phi  Muon_Charge/I
+    Electron_size/I  Electron_PT[Electron_size]/F  ...  Electron_Charge/I
+    MissingET_MET/F  MissingET_Phi/F
+    Event_Number/L   Event_Weight/F
+
+The *_size branches are the offsets of each collection: event i owns the
+next *_size values of every column of that collection. Kinematics are
+compressed with LZ4, which is the fastest to decode, the small integer
+columns with ZSTD. Baskets and clusters are large, since skims are read
+front to back in whole-file scans.
+
+FlatEvent reads (and books) such a tree with the same member names as the
+Delphes class, so the selection code takes either of them. Skims made
+before Event_Weight existed lack it, and read with a weight of 1.
+*/
+
+const char *FLAT_TREE_NAME = "Events";
+const int FLAT_COMPRESSION_FLOAT = 404;  // LZ4, level 4
+const int FLAT_COMPRESSION_INT = 505;    // ZSTD, level 5
+const Long64_t FLAT_AUTOFLUSH = -64000000;  // clusters of about 64 MB
+const Int_t FLAT_BASKET_SIZE = 1024000;
+
+class FlatEvent
+{
+    public:
+        static constexpr Int_t kMaxJet = Delphes::kMaxJet;
+        static constexpr Int_t kMaxMuon = Delphes::kMaxMuon;
+        static constexpr Int_t kMaxElectron = Delphes::kMaxElectron;
+
+        TTree *fChain = nullptr;
+
+        Int_t    Jet_size = 0;
+        Float_t  Jet_PT[kMaxJet];
+        Float_t  Jet_Eta[kMaxJet];
+        Float_t  Jet_Phi[kMaxJet];
+        Float_t  Jet_Mass[kMaxJet];
+        UInt_t   Jet_BTag[kMaxJet];
+        UInt_t   Jet_TauTag[kMaxJet];
+        Int_t    Jet_Charge[kMaxJet];
+
+        Int_t    Muon_size = 0;
+        Float_t  Muon_PT[kMaxMuon];
+        Float_t  Muon_Eta[kMaxMuon];
+        Float_t  Muon_Phi[kMaxMuon];
+        Int_t    Muon_Charge[kMaxMuon];
+
+        Int_t    Electron_size = 0;
+        Float_t  Electron_PT[kMaxElectron];
+        Float_t  Electron_Eta[kMaxElectron];
+        Float_t  Electron_Phi[kMaxElectron];
+        Int_t    Electron_Charge[kMaxElectron];
+
+        // Always one MissingET and one Event, kept as arrays for the
+        // Delphes-style MissingET_MET[0] access
+        Int_t    MissingET_size = 1;
+        Float_t  MissingET_MET[1];
+        Float_t  MissingET_Phi[1];
+        Long64_t Event_Number[1];
+        Float_t  Event_Weight[1] = {1};
+
+        FlatEvent(TTree *tree = nullptr)
+        {
+            if (tree != nullptr) Init(tree);
+        }
+        // Like the Delphes class, the reader owns the file of its tree
+        virtual ~FlatEvent()
+        {
+            if (fChain != nullptr) delete fChain->GetCurrentFile();
+        }
+
+        void Init(TTree *tree)
+        {
+            fChain = tree;
+            for (const auto &column : Columns())
+            {
+                if (fChain->GetBranch(column.name) != nullptr) fChain->SetBranchAddress(column.name, column.address);
+            }
+        }
+
+        Int_t GetEntry(Long64_t entry)
+        {
+            return fChain->GetEntry(entry);
+        }
+
+        // Creates the columns in tree, which should be empty
+        void Book(TTree *tree)
+        {
+            for (const auto &column : Columns())
+            {
+                TBranch *branch = tree->Branch(column.name, column.address, column.leaflist, FLAT_BASKET_SIZE);
+                branch->SetCompressionSettings(column.compression);
+            }
+            tree->SetAutoFlush(FLAT_AUTOFLUSH);
+        }
+
+        // Copies the skimmed columns out of a Delphes-like reader
+        template <class Event>
+        void CopyFrom(Event *event)
+        {
+            Jet_size = TMath::Min(event->Jet_size, kMaxJet);
+            for (int i=0; i<Jet_size; i++)
+            {
+                Jet_PT[i] = event->Jet_PT[i];
+                Jet_Eta[i] = event->Jet_Eta[i];
+                Jet_Phi[i] = event->Jet_Phi[i];
+                Jet_Mass[i] = event->Jet_Mass[i];
+                Jet_BTag[i] = event->Jet_BTag[i];
+                Jet_TauTag[i] = event->Jet_TauTag[i];
+                Jet_Charge[i] = event->Jet_Charge[i];
+            }
+            Muon_size = TMath::Min(event->Muon_size, kMaxMuon);
+            for (int i=0; i<Muon_size; i++)
+            {
+                Muon_PT[i] = event->Muon_PT[i];
+                Muon_Eta[i] = event->Muon_Eta[i];
+                Muon_Phi[i] = event->Muon_Phi[i];
+                Muon_Charge[i] = event->Muon_Charge[i];
+            }
+            Electron_size = TMath::Min(event->Electron_size, kMaxElectron);
+            for (int i=0; i<Electron_size; i++)
+            {
+                Electron_PT[i] = event->Electron_PT[i];
+                Electron_Eta[i] = event->Electron_Eta[i];
+                Electron_Phi[i] = event->Electron_Phi[i];
+                Electron_Charge[i] = event->Electron_Charge[i];
+            }
+            MissingET_MET[0] = event->MissingET_MET[0];
+            MissingET_Phi[0] = event->MissingET_Phi[0];
+            Event_Number[0] = event->Event_Number[0];
+            Event_Weight[0] = event->Event_Weight[0];
+        }
+
+    private:
+        struct Column
+        {
+            const char *name;
+            void *address;
+            const char *leaflist;
+            int compression;
+        };
+
+        std::vector<Column> Columns()
+        {
+            const int F = FLAT_COMPRESSION_FLOAT;
+            const int I = FLAT_COMPRESSION_INT;
+            return {
+                {"Jet_size", &Jet_size, "Jet_size/I", I},
+                {"Jet_PT", Jet_PT, "Jet_PT[Jet_size]/F", F},
+                {"Jet_Eta", Jet_Eta, "Jet_Eta[Jet_size]/F", F},
+                {"Jet_Phi", Jet_Phi, "Jet_Phi[Jet_size]/F", F},
+                {"Jet_Mass", Jet_Mass, "Jet_Mass[Jet_size]/F", F},
+                {"Jet_BTag", Jet_BTag, "Jet_BTag[Jet_size]/i", I},
+                {"Jet_TauTag", Jet_TauTag, "Jet_TauTag[Jet_size]/i", I},
+                {"Jet_Charge", Jet_Charge, "Jet_Charge[Jet_size]/I", I},
+                {"Muon_size", &Muon_size, "Muon_size/I", I},
+                {"Muon_PT", Muon_PT, "Muon_PT[Muon_size]/F", F},
+                {"Muon_Eta", Muon_Eta, "Muon_Eta[Muon_size]/F", F},
+                {"Muon_Phi", Muon_Phi, "Muon_Phi[Muon_size]/F", F},
+                {"Muon_Charge", Muon_Charge, "Muon_Charge[Muon_size]/I", I},
+                {"Electron_size", &Electron_size, "Electron_size/I", I},
+                {"Electron_PT", Electron_PT, "Electron_PT[Electron_size]/F", F},
+                {"Electron_Eta", Electron_Eta, "Electron_Eta[Electron_size]/F", F},
+                {"Electron_Phi", Electron_Phi, "Electron_Phi[Electron_size]/F", F},
+                {"Electron_Charge", Electron_Charge, "Electron_Charge[Electron_size]/I", I},
+                {"MissingET_MET", MissingET_MET, "MissingET_MET/F", F},
+                {"MissingET_Phi", MissingET_Phi, "MissingET_Phi/F", F},
+                {"Event_Number", Event_Number, "Event_Number/L", I},
+                {"Event_Weight", Event_Weight, "Event_Weight/F", F},
+            };
+        }
+};
+
+// True if filename holds a flat skim rather than a Delphes tree
+bool is_flat_file(const std::string &filename)
+{
+    TFile *infile = TFile::Open(filename.c_str());
+    bool flat = infile != nullptr and !infile->IsZombie() and infile->Get(FLAT_TREE_NAME) != nullptr;
+    delete infile;
+    return flat;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef fcc_higgs_friend_h
+#define fcc_higgs_friend_h
+
+#include <TTree.h>
+
+/*
+Derived per-event quantities of the v3 selection, written by
+read_fcc_higgs_v3 with the option friend to OUTPUT.friend.root as the tree
+"derived", one entry per entry of the input chain, so that
+
+    chain->AddFriend("derived", "OUTPUT.friend.root");
+
+gives every event its quantities without running the selection again.
+Per event:
+    number          Event.Number, to check the alignment
+    passed_veto     1 if the event passed the lepton veto; all the rest is
+                    only filled for such events (0, or -1 for indices)
+    njet, nbjet     selected jets (pT > 30 GeV, |eta| < 6) and b-tagged ones
+and per channel ([0] mutau_e, [1] etau_mu):
+    mu, ele         index of the muon and electron chosen by the selection,
+                    -1 unless it found exactly one of each
+    mass_collinear, x_vis_tau, pt_nu_est
+                    as filled in the cut flow histograms
+    dphi_e_met, dphi_mu_met, dphi_e_mu
+                    of the chosen leptons, or of the first muon and
+                    electron of the event as for the collinear mass; -1
+                    without a muon or electron
+*/
+
+const char *FRIEND_TREE_NAME = "derived";
+
+struct DerivedQuantities
+{
+    Long64_t number = 0;
+    Int_t passed_veto = 0;
+    Int_t njet = 0;
+    Int_t nbjet = 0;
+    Int_t mu[2];
+    Int_t ele[2];
+    Float_t mass_collinear[2];
+    Float_t x_vis_tau[2];
+    Float_t pt_nu_est[2];
+    Float_t dphi_e_met[2];
+    Float_t dphi_mu_met[2];
+    Float_t dphi_e_mu[2];
+
+    void Clear()
+    {
+        passed_veto = 0;
+        njet = 0;
+        nbjet = 0;
+        for (int c=0; c<2; c++)
+        {
+            mu[c] = -1;
+            ele[c] = -1;
+            mass_collinear[c] = 0;
+            x_vis_tau[c] = 0;
+            pt_nu_est[c] = 0;
+            dphi_e_met[c] = -1;
+            dphi_mu_met[c] = -1;
+            dphi_e_mu[c] = -1;
+        }
+    }
+
+    void Book(TTree *tree)
+    {
+        tree->Branch("number", &number, "number/L");
+        tree->Branch("passed_veto", &passed_veto, "passed_veto/I");
+        tree->Branch("njet", &njet, "njet/I");
+        tree->Branch("nbjet", &nbjet, "nbjet/I");
+        tree->Branch("mu", mu, "mu[2]/I");
+        tree->Branch("ele", ele, "ele[2]/I");
+        tree->Branch("mass_collinear", mass_collinear, "mass_collinear[2]/F");
+        tree->Branch("x_vis_tau", x_vis_tau, "x_vis_tau[2]/F");
+        tree->Branch("pt_nu_est", pt_nu_est, "pt_nu_est[2]/F");
+        tree->Branch("dphi_e_met", dphi_e_met, "dphi_e_met[2]/F");
+        tree->Branch("dphi_mu_met", dphi_mu_met, "dphi_mu_met[2]/F");
+        tree->Branch("dphi_e_mu", dphi_e_mu, "dphi_e_mu[2]/F");
+    }
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef fcc_higgs_metrics_h
+#define fcc_higgs_metrics_h
+
+#include <stdio.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include <TString.h>
+#include <TSystem.h>
+
+/*
+Live metrics of an engine run, for job monitoring without parsing logs.
+
+Every metrics=S seconds (default 10) and once at the end, run_fcc_higgs
+replaces OUTPUT.metrics.json, written to OUTPUT.metrics.json.tmp and
+renamed, so a reader always sees a whole file:
+
+    elapsed, processed, total, events_per_s, eta   progress of the run
+    bytes_read      bytes read from ROOT files (not column caches)
+    read_seconds    thread-seconds in GetEntry, i.e. reading and
+                    decompressing, of all copies of all chunks
+    rss_kb          resident memory of the process
+    steps           entries of every cut flow histogram of the signal
+                    region so far, summed over the samples
+    threads         per thread its events, busy seconds, seconds since it
+                    last finished a chunk and whether it is still running;
+                    a running thread whose last chunk is long ago is stuck
+    finished        true in the last write
+
+pyinterface.py prints it while the engine runs.
+*/
+
+struct ThreadMetrics
+{
+    Long64_t events = 0;
+    double busy_seconds = 0;
+    double last_chunk = 0;  // seconds since the start of the run
+    bool running = true;
+};
+
+struct RunMetrics
+{
+    double elapsed = 0;
+    Long64_t processed = 0;
+    Long64_t total = 0;
+    Long64_t bytes_read = 0;
+    double read_seconds = 0;
+    Long_t rss_kb = 0;
+    bool finished = false;
+    std::vector<std::pair<std::string, double>> steps;
+    std::vector<ThreadMetrics> threads;
+
+    double Rate() const { return elapsed > 0 ? processed / elapsed : 0; }
+    // Seconds left at the current rate, -1 before any event
+    double Eta() const { return Rate() > 0 ? (total - processed) / Rate() : -1; }
+};
+
+bool write_metrics(const TString &path, const RunMetrics &metrics)
+{
+    TString tmp = path + ".tmp";
+    FILE *out = fopen(tmp.Data(), "w");
+    if (out == nullptr) return false;
+    fprintf(out, "{\n");
+    fprintf(out, "  \"elapsed\": %.3f,\n", metrics.elapsed);
+    fprintf(out, "  \"processed\": %lld,\n", metrics.processed);
+    fprintf(out, "  \"total\": %lld,\n", metrics.total);
+    fprintf(out, "  \"events_per_s\": %.2f,\n", metrics.Rate());
+    fprintf(out, "  \"eta\": %.1f,\n", metrics.Eta());
+    fprintf(out, "  \"bytes_read\": %lld,\n", metrics.bytes_read);
+    fprintf(out, "  \"read_seconds\": %.3f,\n", metrics.read_seconds);
+    fprintf(out, "  \"rss_kb\": %ld,\n", metrics.rss_kb);
+    fprintf(out, "  \"finished\": %s,\n", metrics.finished ? "true" : "false");
+    fprintf(out, "  \"steps\": {");
+    for (size_t i=0; i<metrics.steps.size(); i++)
+    {
+        fprintf(out, "%s\n    \"%s\": %.0f", i == 0 ? "" : ",", metrics.steps[i].first.c_str(), metrics.steps[i].second);
+    }
+    fprintf(out, "\n  },\n");
+    fprintf(out, "  \"threads\": [");
+    for (size_t w=0; w<metrics.threads.size(); w++)
+    {
+        const ThreadMetrics &thread = metrics.threads[w];
+        fprintf(out, "%s\n    {\"events\": %lld, \"busy_seconds\": %.3f, \"since_last_chunk\": %.1f, \"running\": %s}", w == 0 ? "" : ",",
+                thread.events, thread.busy_seconds, metrics.elapsed - thread.last_chunk, thread.running ? "true" : "false");
+    }
+    fprintf(out, "\n  ]\n}\n");
+    fclose(out);
+    return gSystem->Rename(tmp, path) == 0;
+}
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef fcc_higgs_samples_h
+#define fcc_higgs_samples_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <TString.h>
+#include <TSystem.h>
+
+/*
+Sample catalogue of a multi-sample engine run.
+
+With the option catalogue, the INPUT of run_fcc_higgs is a tab separated
+file with one line per input (or glob) of a sample:
+
+    # sample      cross-section [pb]   input
+    ttbar_hvq     31429.12             /path/hvqMulti1M/events_0.root
+    mutauM200     0.001                ../data/LFV_mutau/M200/output_powheg_M200.root
+
+Lines of one sample may repeat, one per input; blank lines and lines
+starting with # are skipped. pyinterface.py --process all writes it from
+processes.py. The chunks of all samples go to one scheduler, every chunk
+is filled into the histograms of its sample, and each sample is saved in
+a directory of its own, scaled to the luminosity.
+
+A dataset catalogue (DatasetCatalogue, catalogue.py on the Python side) is
+the same file with one line per input file and four more columns:
+
+    entries  bytes  sum_weights  mtime
+
+the entries of the event tree, the file size, the sum of the event weights
+(for a skim, of its whole input: skim_input_sum_weights) and the last
+modification time, -1 where not known yet; entries alone tells whether a
+line is known, as the sum of weights of a file of a negative-weight NLO
+sample can be below 0. Lines are kept sorted by sample
+and input, so a sample is one block of the file. make-catalogue.cpp fills
+in the missing and stale columns; a sample whose lines are all known is
+normalised with the sum of weights of the catalogue, without depending on
+which of its events a run actually read.
+
+A sample named PROCESS/COMPONENT is one production of PROCESS, e.g. the
+ttbar_hvq productions hvqMulti1M, hvqMulti10M and hvqMulti10M_set2.
+Every component is normalised on its own sum of weights and saved in the
+directory PROCESS/COMPONENT; the directory PROCESS holds the components
+stitched together, each weighted by its share of the summed luminosity
+(sum of weights / cross-section), i.e. their histograms summed and scaled
+by lumi * cross-section / their summed sum of weights. The components of a
+process share its cross-section. stitch-fcc-higgs.cpp redoes the stitching
+from saved outputs, so a new production is run on its own and stitched to
+the ones already processed.
+*/
+
+struct CatalogueRow
+{
+    std::string sample;
+    double cross_section = 0;  // pb
+    std::string input;
+    Long64_t entries = -1;
+    Long64_t bytes = -1;
+    double sum_weights = -1;
+    Long64_t mtime = -1;
+
+    bool Known() const { return entries >= 0; }
+
+    // True if the file still has the size and mtime its columns were taken with
+    bool Current() const
+    {
+        FileStat_t stat;
+        if (gSystem->GetPathInfo(input.c_str(), stat) != 0) return false;
+        return stat.fSize == bytes and stat.fMtime == mtime;
+    }
+
+    bool operator<(const CatalogueRow &other) const
+    {
+        return sample != other.sample ? sample < other.sample : input < other.input;
+    }
+};
+
+class DatasetCatalogue
+{
+    public:
+        // Returns false if path cannot be read
+        bool Read(const std::string &path)
+        {
+            std::ifstream in(path);
+            if (!in.is_open()) return false;
+            std::string line;
+            while (std::getline(in, line))
+            {
+                if (line.empty() or line[0] == '#') continue;
+                std::vector<std::string> fields;
+                std::istringstream columns(line);
+                std::string field;
+                while (std::getline(columns, field, '\t')) fields.push_back(field);
+                if (fields.size() < 3)
+                {
+                    printf("Skipping catalogue line %s\n", line.c_str());
+                    continue;
+                }
+                CatalogueRow row;
+                row.sample = fields[0];
+                row.cross_section = atof(fields[1].c_str());
+                row.input = fields[2];
+                if (fields.size() >= 7)
+                {
+                    row.entries = atoll(fields[3].c_str());
+                    row.bytes = atoll(fields[4].c_str());
+                    row.sum_weights = atof(fields[5].c_str());
+                    row.mtime = atoll(fields[6].c_str());
+                }
+                rows.push_back(row);
+            }
+            return true;
+        }
+
+        // Sorted, to PATH.tmp and renamed over path
+        bool Write(const std::string &path)
+        {
+            std::stable_sort(rows.begin(), rows.end());
+            TString tmp = Form("%s.tmp", path.c_str());
+            FILE *out = fopen(tmp.Data(), "w");
+            if (out == nullptr) return false;
+            fprintf(out, "# sample\tcross_section\tinput\tentries\tbytes\tsum_weights\tmtime\n");
+            for (const auto &row : rows)
+            {
+                fprintf(out, "%s\t%.10g\t%s\t%lld\t%lld\t%.10g\t%lld\n", row.sample.c_str(), row.cross_section, row.input.c_str(),
+                        row.entries, row.bytes, row.sum_weights, row.mtime);
+            }
+            fclose(out);
+            return gSystem->Rename(tmp, path.c_str()) == 0;
+        }
+
+        std::vector<CatalogueRow> rows;
+};
+
+struct Sample
+{
+    std::string name;
+    double cross_section = 0;  // pb
+    std::vector<std::string> inputs;
+    // Totals of the catalogue, if known for every input
+    bool known = false;
+    Long64_t entries = -1;
+    double sum_weights = 0;
+};
+
+// PROCESS of a sample PROCESS/COMPONENT, "" if the sample is not a component
+std::string sample_process(const std::string &name)
+{
+    size_t slash = name.find('/');
+    return slash == std::string::npos ? "" : name.substr(0, slash);
+}
+
+// The samples in order of first appearance, empty if path cannot be read
+std::vector<Sample> read_sample_catalogue(const std::string &path)
+{
+    std::vector<Sample> samples;
+    DatasetCatalogue catalogue;
+    if (!catalogue.Read(path)) return samples;
+    for (const auto &row : catalogue.rows)
+    {
+        size_t s = 0;
+        while (s < samples.size() and samples[s].name != row.sample) s++;
+        if (s == samples.size())
+        {
+            samples.emplace_back();
+            samples.back().name = row.sample;
+            samples.back().cross_section = row.cross_section;
+            samples.back().entries = 0;
+            samples.back().known = true;
+        }
+        samples[s].inputs.push_back(row.input);
+        samples[s].known = samples[s].known and row.Known() and row.Current();
+        samples[s].entries += row.entries;
+        samples[s].sum_weights += row.sum_weights;
+    }
+    for (auto &sample : samples)
+    {
+        if (sample.known) continue;
+        sample.entries = -1;
+        sample.sum_weights = 0;
+    }
+    return samples;
+}
+
+#endif
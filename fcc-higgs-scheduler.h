@@ -0,0 +1,345 @@
+#ifndef fcc_higgs_scheduler_h
+#define fcc_higgs_scheduler_h
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Work-stealing scheduler for entry ranges of a dataset.
+
+Work is submitted as spans, typically one per input file. Submit() sorts
+them by size, biggest first, and deals them round-robin over the per-worker
+deques. A worker cuts its next chunk off the front span of its own deque;
+once that runs dry it cuts from the front span of the worker with the most
+entries still queued. Chunks end on cluster boundaries when the cluster
+layout of the file is known (SetClusters), so no basket is read twice.
+
+Once nothing is queued, idle workers look for stragglers: chunks running
+longer than slow_factor times what the measured rate predicts. Such a chunk
+is handed out a second time (speculative copy). Whichever copy calls
+Finish() first owns the result, the other gets false from Finish() (and
+true from Cancelled() while it still runs) and must drop what it filled,
+so nothing is counted twice.
+
+Chunks are half-open entry ranges [first, last) of one input file.
+*/
+
+struct Chunk
+{
+    int file;
+    long long first;
+    long long last;
+    int task = -1;
+    bool speculative = false;
+    long long Entries() const { return last - first; }
+};
+
+class WorkStealingScheduler
+{
+    public:
+        // slow_factor <= 0 turns speculative copies off
+        WorkStealingScheduler(int nworkers, double slow_factor = 0, double min_slow_seconds = 10)
+            : slow(slow_factor), min_slow(min_slow_seconds)
+        {
+            for (int w=0; w<nworkers; w++) queues.emplace_back(new WorkerQueue());
+        }
+
+        // ends holds the (exclusive) last entry of every cluster of the file
+        void SetClusters(int file, std::vector<long long> ends)
+        {
+            if (file >= (int) cluster_ends.size()) cluster_ends.resize(file + 1);
+            cluster_ends[file] = ends;
+        }
+
+        void Submit(std::vector<Chunk> spans)
+        {
+            std::stable_sort(spans.begin(), spans.end(),
+                [](const Chunk &a, const Chunk &b) { return a.Entries() > b.Entries(); });
+            for (size_t i=0; i<spans.size(); i++)
+            {
+                WorkerQueue &q = *queues[i % queues.size()];
+                std::lock_guard<std::mutex> lock(q.mutex);
+                q.chunks.push_back(spans[i]);
+                q.entries += spans[i].Entries();
+            }
+        }
+
+        // Fills chunk with the next piece of work for this worker, of about
+        // want entries (the whole span if want <= 0). rate is the expected
+        // events/s of one worker, used to spot stragglers. Returns false
+        // once every chunk is finished.
+        bool Next(int worker, Chunk &chunk, long long want = 0, double rate = 0)
+        {
+            return Next(worker, chunk, [want](const Chunk &) { return want; }, [rate](const Chunk &) { return rate; });
+        }
+
+        // The same, with the size of a chunk cut from a span and the
+        // expected rate of a running chunk depending on them, e.g. on the
+        // sample of their file. Both are called with a lock of the
+        // scheduler held, so they must not call it.
+        bool Next(int worker, Chunk &chunk, const std::function<long long(const Chunk &)> &want, const std::function<double(const Chunk &)> &rate)
+        {
+            while (true)
+            {
+                if (Take(worker, chunk, want))
+                {
+                    Register(chunk);
+                    return true;
+                }
+                if (slow <= 0) return false;
+                if (Speculate(chunk, rate)) return true;
+                {
+                    std::lock_guard<std::mutex> lock(task_mutex);
+                    if (running.empty()) return false;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+        }
+
+        // Returns true if this copy is the first to finish the chunk and
+        // its result should be kept
+        bool Finish(const Chunk &chunk)
+        {
+            std::lock_guard<std::mutex> lock(task_mutex);
+            auto it = running.find(chunk.task);
+            if (it == running.end()) return false;
+            bool first = !it->second.done;
+            it->second.done = true;
+            if (--it->second.copies == 0) running.erase(it);
+            if (first and chunk.speculative) speculative_wins++;
+            return first;
+        }
+
+        // True once another copy of this chunk has finished
+        bool Cancelled(const Chunk &chunk)
+        {
+            std::lock_guard<std::mutex> lock(task_mutex);
+            auto it = running.find(chunk.task);
+            return it == running.end() or it->second.done;
+        }
+
+        // Entries not yet handed out
+        long long Remaining()
+        {
+            long long remaining = 0;
+            for (auto &q : queues)
+            {
+                std::lock_guard<std::mutex> lock(q->mutex);
+                remaining += q->entries;
+            }
+            return remaining;
+        }
+
+        int Steals()
+        {
+            std::lock_guard<std::mutex> lock(task_mutex);
+            return steals;
+        }
+
+        int Speculated()
+        {
+            std::lock_guard<std::mutex> lock(task_mutex);
+            return speculative_launched;
+        }
+
+        int SpeculativeWins()
+        {
+            std::lock_guard<std::mutex> lock(task_mutex);
+            return speculative_wins;
+        }
+
+    private:
+        struct WorkerQueue
+        {
+            std::mutex mutex;
+            std::deque<Chunk> chunks;
+            long long entries = 0;
+        };
+
+        struct Task
+        {
+            Chunk chunk;
+            std::chrono::steady_clock::time_point start;
+            int copies = 1;
+            bool done = false;
+        };
+
+        // Own deque first, then the fullest one
+        bool Take(int worker, Chunk &chunk, const std::function<long long(const Chunk &)> &want)
+        {
+            if (Pop(*queues[worker], chunk, want)) return true;
+            while (true)
+            {
+                int victim = -1;
+                long long most = 0;
+                for (size_t w=0; w<queues.size(); w++)
+                {
+                    std::lock_guard<std::mutex> lock(queues[w]->mutex);
+                    if (queues[w]->entries > most or (most == 0 and !queues[w]->chunks.empty()))
+                    {
+                        most = queues[w]->entries;
+                        victim = w;
+                    }
+                }
+                if (victim < 0) return false;
+                if (Pop(*queues[victim], chunk, want))
+                {
+                    std::lock_guard<std::mutex> lock(task_mutex);
+                    steals++;
+                    return true;
+                }
+                // someone else emptied the victim in the meantime, look again
+            }
+        }
+
+        void Register(Chunk &chunk)
+        {
+            std::lock_guard<std::mutex> lock(task_mutex);
+            chunk.task = next_task++;
+            chunk.speculative = false;
+            Task task;
+            task.chunk = chunk;
+            task.start = std::chrono::steady_clock::now();
+            running[chunk.task] = task;
+        }
+
+        // Hand out a second copy of the most overdue running chunk, if it
+        // has taken more than slow times its expected duration
+        bool Speculate(Chunk &chunk, const std::function<double(const Chunk &)> &rate)
+        {
+            std::lock_guard<std::mutex> lock(task_mutex);
+            auto now = std::chrono::steady_clock::now();
+            double worst = 0;
+            Task *straggler = nullptr;
+            for (auto &entry : running)
+            {
+                Task &task = entry.second;
+                if (task.done or task.copies > 1) continue;
+                double task_rate = rate(task.chunk);
+                if (task_rate <= 0) continue;
+                double elapsed = std::chrono::duration<double>(now - task.start).count();
+                double expected = task.chunk.Entries() / task_rate;
+                if (elapsed < min_slow or elapsed < slow * expected) continue;
+                if (elapsed / expected > worst)
+                {
+                    worst = elapsed / expected;
+                    straggler = &task;
+                }
+            }
+            if (straggler == nullptr) return false;
+            straggler->copies++;
+            speculative_launched++;
+            chunk = straggler->chunk;
+            chunk.speculative = true;
+            return true;
+        }
+
+        // First cluster boundary at or after first + want inside span
+        long long CutPoint(const Chunk &span, long long want) const
+        {
+            long long cut = span.first + want;
+            if (span.file < (int) cluster_ends.size() and !cluster_ends[span.file].empty())
+            {
+                const std::vector<long long> &ends = cluster_ends[span.file];
+                auto it = std::lower_bound(ends.begin(), ends.end(), cut);
+                cut = it == ends.end() ? span.last : *it;
+            }
+            return std::min(cut, span.last);
+        }
+
+        bool Pop(WorkerQueue &q, Chunk &chunk, const std::function<long long(const Chunk &)> &want)
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.chunks.empty()) return false;
+            Chunk &span = q.chunks.front();
+            chunk = span;
+            long long size = want(span);
+            if (size > 0) chunk.last = CutPoint(span, size);
+            if (chunk.last >= span.last) q.chunks.pop_front();
+            else span.first = chunk.last;
+            q.entries -= chunk.Entries();
+            return true;
+        }
+
+        std::vector<std::unique_ptr<WorkerQueue>> queues;
+        std::vector<std::vector<long long>> cluster_ends;
+
+        double slow;
+        double min_slow;
+        std::mutex task_mutex;
+        std::map<int, Task> running;
+        int next_task = 0;
+        int steals = 0;
+        int speculative_launched = 0;
+        int speculative_wins = 0;
+};
+
+/*
+Picks chunk sizes from the measured throughput, so that one chunk takes
+about target_seconds: long enough to amortise opening the file and warming
+the basket cache, short enough to keep the threads balanced. The rate is a
+running average over finished chunks, kept per key (the engine uses the
+sample of the file) as the cost per event depends on the sample: signal
+reaches the collinear mass, most ttbar dies at the lepton veto. A key
+without a finished chunk yet uses the average over all chunks.
+*/
+class ChunkSizer
+{
+    public:
+        ChunkSizer(double target_seconds, long long initial_entries, long long min_entries = 1000, long long max_entries = 10000000)
+            : target(target_seconds), initial(initial_entries), min_size(min_entries), max_size(max_entries) { }
+
+        long long Size(int key = -1)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            double key_rate = KeyRate(key);
+            if (target <= 0 or key_rate <= 0) return initial;
+            long long size = (long long) (key_rate * target);
+            return std::max(min_size, std::min(max_size, size));
+        }
+
+        // Per-thread events/s of a finished chunk
+        void Record(long long entries, double seconds, int key = -1)
+        {
+            if (entries <= 0 or seconds <= 0) return;
+            std::lock_guard<std::mutex> lock(mutex);
+            double measured = entries / seconds;
+            rate = rate <= 0 ? measured : smoothing * measured + (1 - smoothing) * rate;
+            if (key < 0) return;
+            auto it = rates.find(key);
+            if (it == rates.end()) rates[key] = measured;
+            else it->second = smoothing * measured + (1 - smoothing) * it->second;
+        }
+
+        double Rate(int key = -1)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return KeyRate(key);
+        }
+
+    private:
+        // The rate of key, the overall one until key has a measurement
+        double KeyRate(int key) const
+        {
+            auto it = rates.find(key);
+            return it == rates.end() ? rate : it->second;
+        }
+
+        std::mutex mutex;
+        double target;
+        long long initial;
+        long long min_size;
+        long long max_size;
+        double rate = 0;
+        std::map<int, double> rates;
+        const double smoothing = 0.3;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef fcc_higgs_unbinned_h
+#define fcc_higgs_unbinned_h
+
+#include <vector>
+#include <TFile.h>
+#include <TString.h>
+#include <TTree.h>
+#include "fcc-higgs-decisions.h"
+
+/*
+Unbinned events of the final categories.
+
+Besides the histograms, SelectionV3 keeps one SelectedEvent per fill of a
+highmass or lowmass histogram, and SaveAll writes them to the tree
+"selected_events" (channel, highmass, njet as bytes, mass and weight as
+floats, 10 bytes an event before compression). rebin-fcc-higgs.cpp turns
+them into histograms with any binning or mass window, without running the
+selection again.
+*/
+
+const char *SELECTED_TREE_NAME = "selected_events";
+
+struct SelectedEvent
+{
+    UChar_t channel;   // DECISION_MUTAUE or DECISION_ETAUMU
+    UChar_t highmass;  // 1 highmass, 0 lowmass
+    UChar_t njet;
+    Float_t mass;
+    Float_t weight;
+};
+
+// Name of the cut flow histogram of the category, e.g. mutau_e_lowmass_0j
+TString selected_hist_name(int channel, int highmass, int njet)
+{
+    return Form("%s_%s_%dj", DECISION_CHANNEL_NAMES[channel], highmass ? "highmass" : "lowmass", njet);
+}
+
+void write_selected_events(TDirectory *outfile, const std::vector<SelectedEvent> &events)
+{
+    outfile->cd();
+    SelectedEvent event;
+    TTree *tree = new TTree(SELECTED_TREE_NAME, "unbinned events of the final categories");
+    tree->Branch("channel", &event.channel, "channel/b");
+    tree->Branch("highmass", &event.highmass, "highmass/b");
+    tree->Branch("njet", &event.njet, "njet/b");
+    tree->Branch("mass", &event.mass, "mass/F");
+    tree->Branch("weight", &event.weight, "weight/F");
+    for (const auto &e : events)
+    {
+        event = e;
+        tree->Fill();
+    }
+    tree->Write();
+    delete tree;
+}
+
+// Appends the events of tree to events
+void read_selected_events(TTree *tree, std::vector<SelectedEvent> &events)
+{
+    SelectedEvent event;
+    tree->SetBranchAddress("channel", &event.channel);
+    tree->SetBranchAddress("highmass", &event.highmass);
+    tree->SetBranchAddress("njet", &event.njet);
+    tree->SetBranchAddress("mass", &event.mass);
+    tree->SetBranchAddress("weight", &event.weight);
+    events.reserve(events.size() + tree->GetEntries());
+    for (Long64_t i=0; i<tree->GetEntries(); i++)
+    {
+        tree->GetEntry(i);
+        events.push_back(event);
+    }
+    tree->ResetBranchAddresses();
+}
+
+// Returns false if the file has no selected events
+bool read_selected_events(TDirectory *infile, std::vector<SelectedEvent> &events)
+{
+    TTree *tree = nullptr;
+    infile->GetObject(SELECTED_TREE_NAME, tree);
+    if (tree == nullptr) return false;
+    read_selected_events(tree, events);
+    delete tree;
+    return true;
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef fcc_higgs_universes_h
+#define fcc_higgs_universes_h
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <TMath.h>
+#include "fcc-higgs-flat.h"
+
+/*
+Systematic universes: the event with its jet, muon and electron pT scaled,
+and the MET recomputed from the shifted objects.
+
+The input is read once and the event copied once into a FlatEvent, whose
+columns are plain arrays per quantity. For each universe in turn only its
+pT columns and MET are rewritten from the event, scaled, and the scalar
+v3 selection runs on the copy like on any other reader. A universe thus
+costs a rewrite of three pT columns and one cut flow, while the reading is
+shared.
+
+This is not a layout of K shifted copies side by side with the selection
+evaluated over all K at once: that would need a second implementation of
+the v3 cut flow working across universes next to SelectionV3, and two
+versions of the cuts to keep in step. The cost per extra universe has not
+been measured against that; bench-universes.cpp prints it for a given file
+(seconds per universe over K = 0, next to K + 1 separate reruns).
+
+The scales are the usual one-sigma placeholders of the FCC-hh Delphes
+card studies; change VARIATIONS, or pick a subset with universes=NAME,...
+*/
+
+struct Variation
+{
+    const char *name;
+    float jet_scale;
+    float muon_scale;
+    float electron_scale;
+};
+const std::vector<Variation> VARIATIONS = {
+    {"jes_up", 1.03, 1, 1},
+    {"jes_down", 0.97, 1, 1},
+    {"mes_up", 1, 1.01, 1},
+    {"mes_down", 1, 0.99, 1},
+    {"ees_up", 1, 1, 1.01},
+    {"ees_down", 1, 1, 0.99},
+};
+
+// The VARIATIONS named in a comma separated list, all of them for "" or "all"
+std::vector<Variation> parse_variations(const std::string &names)
+{
+    if (names.empty() or names == "all") return VARIATIONS;
+    std::vector<Variation> variations;
+    size_t start = 0;
+    while (start <= names.size())
+    {
+        size_t comma = names.find(',', start);
+        if (comma == std::string::npos) comma = names.size();
+        std::string name = names.substr(start, comma - start);
+        bool found = false;
+        for (const auto &variation : VARIATIONS)
+        {
+            if (name == variation.name)
+            {
+                variations.push_back(variation);
+                found = true;
+            }
+        }
+        if (!found and !name.empty()) printf("Unknown variation %s\n", name.c_str());
+        start = comma + 1;
+    }
+    return variations;
+}
+
+// Sets the pT columns of shifted, a copy of event (FlatEvent::CopyFrom),
+// to those of event scaled by variation, and its MET to that of event moved
+// by the opposite of the summed shift of the objects
+template <class Event>
+void shift_kinematics(FlatEvent &shifted, Event *event, const Variation &variation)
+{
+    double met_x = event->MissingET_MET[0] * TMath::Cos(event->MissingET_Phi[0]);
+    double met_y = event->MissingET_MET[0] * TMath::Sin(event->MissingET_Phi[0]);
+    auto scale = [&](Float_t *pt, const Float_t *original, const Float_t *phi, int size, float factor)
+    {
+        for (int i=0; i<size; i++)
+        {
+            pt[i] = original[i] * factor;
+            if (factor == 1) continue;
+            double delta = original[i] * (factor - 1);
+            met_x -= delta * TMath::Cos(phi[i]);
+            met_y -= delta * TMath::Sin(phi[i]);
+        }
+    };
+    scale(shifted.Jet_PT, &event->Jet_PT[0], shifted.Jet_Phi, shifted.Jet_size, variation.jet_scale);
+    scale(shifted.Muon_PT, &event->Muon_PT[0], shifted.Muon_Phi, shifted.Muon_size, variation.muon_scale);
+    scale(shifted.Electron_PT, &event->Electron_PT[0], shifted.Electron_Phi, shifted.Electron_size, variation.electron_scale);
+    shifted.MissingET_MET[0] = TMath::Sqrt(met_x * met_x + met_y * met_y);
+    shifted.MissingET_Phi[0] = TMath::ATan2(met_y, met_x);
+}
+
+#endif
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <TStopwatch.h>
+#include "read-fcc-higgs-v3.cpp"
+
+using namespace std;
+
+/*
+Long-lived worker for the v3 selection.
+
+ROOT, the dictionaries and the histograms are set up once, then the worker
+waits for assignments on a named pipe (one per line):
+
+    <input file or glob> <output file> [first entry] [last entry]
+
+and answers each one on a second pipe with
+
+    done <output file> <entries processed> <seconds>
+
+or "error <input file>" if nothing could be read or the range lies outside
+the input. "quit" (or closing the
+pipe) stops the worker. The entry range is optional and half-open; without
+it the whole input is processed, i.e. the same as read_fcc_higgs_v3. Like
+there, flat skims (fcc-higgs-flat.h) are read with FlatEvent.
+
+To run it by hand,
+
+    mkfifo w.in w.out
+    root -l -b -q "fcc-higgs-worker.cpp(\"w.in\", \"w.out\")"
+
+pyinterface.py --worker starts one per core and feeds it through these pipes.
+*/
+
+void fcc_higgs_worker(TString inpipename, TString outpipename)
+{
+    gErrorIgnoreLevel = kFatal;
+
+    // The opening order matters: the dispatcher opens the assignment pipe
+    // first, so we do the same to avoid both sides blocking on open.
+    ifstream inpipe(inpipename.Data());
+    FILE *outpipe = fopen(outpipename.Data(), "w");
+    if (!inpipe.is_open() or outpipe == nullptr)
+    {
+        printf("Cannot open pipes %s, %s\n", inpipename.Data(), outpipename.Data());
+        return;
+    }
+
+    SelectionV3 selection;
+    TChain *intree = nullptr;
+    Delphes *indelphes = nullptr;
+    FlatEvent *inflat = nullptr;
+    bool flat = false;
+    TString current_input = "";
+    TStopwatch timer;
+
+    string line;
+    while (getline(inpipe, line))
+    {
+        istringstream assignment(line);
+        string infilename, outfilename;
+        Long64_t first = 0;
+        Long64_t last = -1;
+        assignment >> infilename;
+        if (infilename.empty()) continue;
+        if (infilename == "quit") break;
+        assignment >> outfilename >> first >> last;
+
+        timer.Start();
+
+        // Only rebuild the chain when the input changes, so that several
+        // entry ranges of the same file reuse the open file and its baskets
+        if (intree == nullptr or current_input != infilename.c_str())
+        {
+            if (intree != nullptr) delete intree;
+            vector<string> filenames = glob(infilename.c_str());
+            flat = !filenames.empty() and is_flat_file(filenames[0]);
+            intree = new TChain(flat ? FLAT_TREE_NAME : "Delphes");
+            for (const auto &filename : filenames)
+            {
+                printf("Reading %s\n", filename.c_str());
+                intree->Add(filename.c_str());
+            }
+            if (flat)
+            {
+                if (inflat == nullptr) inflat = new FlatEvent(intree);
+                else inflat->Init(intree);
+            }
+            else
+            {
+                if (indelphes == nullptr) indelphes = new Delphes(intree);
+                else indelphes->Init(intree);
+                intree->SetBranchStatus("*", 0);
+                intree->SetBranchStatus("Jet*", 1);
+                intree->SetBranchStatus("Electron*", 1);
+                intree->SetBranchStatus("Muon*", 1);
+                intree->SetBranchStatus("MissingET*", 1);
+                intree->SetBranchStatus("Event", 1);
+                intree->SetBranchStatus("Event.Number", 1);
+                intree->SetBranchStatus("Event.Weight", 1);
+            }
+            current_input = infilename.c_str();
+        }
+
+        Long64_t nentries = intree->GetEntries();
+        if (nentries <= 0)
+        {
+            fprintf(outpipe, "error %s\n", infilename.c_str());
+            fflush(outpipe);
+            current_input = "";
+            continue;
+        }
+        if (last < 0 or last > nentries) last = nentries;
+        if (first < 0 or first > last)
+        {
+            printf("Entry range %lld-%lld outside of the %lld events of %s\n", first, last, nentries, infilename.c_str());
+            fprintf(outpipe, "error %s\n", infilename.c_str());
+            fflush(outpipe);
+            continue;
+        }
+
+        selection.Reset();
+        for (Long64_t ievent=first; ievent < last; ievent++)
+        {
+            if (ievent % 10000 == 0) printf("Reading event %lld\n", ievent);
+            if (flat)
+            {
+                inflat->GetEntry(ievent);
+                selection.Process(inflat);
+            }
+            else
+            {
+                indelphes->GetEntry(ievent);
+                selection.Process(indelphes);
+            }
+        }
+        // Once per input, with its first range: the weight a skim dropped
+        if (first == 0) for (const auto &filename : glob(infilename.c_str())) selection.AddSkippedWeight(skim_dropped_weight(filename));
+
+        TFile *outfile = new TFile(outfilename.c_str(), "RECREATE");
+        selection.SaveAll(outfile);
+        outfile->Close();
+        delete outfile;
+
+        timer.Stop();
+        fprintf(outpipe, "done %s %lld %.3f\n", outfilename.c_str(), last - first, timer.RealTime());
+        fflush(outpipe);
+    }
+
+    fclose(outpipe);
+}
@@ -0,0 +1,200 @@
+#ifndef fcc_higgs_zonemap_h
+#define fcc_higgs_zonemap_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <TFile.h>
+#include <TMath.h>
+#include <TTree.h>
+
+/*
+Zone maps: per stored chunk ("zone") of a skim or column cache, the min and
+max of a few key quantities over its events. With requirements such as
+lead_mu_pt>150 the engine can then skip every zone where no event can pass,
+without reading it.
+
+Key quantities, all over every object in the event (no eta or other cuts):
+    lead_mu_pt  leading muon pT (0 without muons)
+    lead_el_pt  leading electron pT (0 without electrons)
+    n_jet, n_mu, n_el  object multiplicities
+    met         missing ET
+
+In ROOT files the zones are the entries of a tree "zonemap" (branches
+first, last, min[], max[]); a zone is one cluster of the event tree. In
+column caches they are the columns zone_first, zone_last, zone_min_<key>
+and zone_max_<key>, a zone being ZONE_ENTRIES entries.
+*/
+
+enum ZoneKey { ZONE_LEAD_MU_PT, ZONE_LEAD_EL_PT, ZONE_N_JET, ZONE_N_MU, ZONE_N_EL, ZONE_MET, ZONE_NKEYS };
+const char *ZONE_KEY_NAMES[ZONE_NKEYS] = {"lead_mu_pt", "lead_el_pt", "n_jet", "n_mu", "n_el", "met"};
+const char *ZONE_TREE_NAME = "zonemap";
+const Long64_t ZONE_ENTRIES = 10000;
+
+template <class Event>
+void zone_values(Event *event, Float_t *values)
+{
+    values[ZONE_LEAD_MU_PT] = 0;
+    for (int i=0; i<event->Muon_size; i++) values[ZONE_LEAD_MU_PT] = TMath::Max(values[ZONE_LEAD_MU_PT], (Float_t) event->Muon_PT[i]);
+    values[ZONE_LEAD_EL_PT] = 0;
+    for (int i=0; i<event->Electron_size; i++) values[ZONE_LEAD_EL_PT] = TMath::Max(values[ZONE_LEAD_EL_PT], (Float_t) event->Electron_PT[i]);
+    values[ZONE_N_JET] = event->Jet_size;
+    values[ZONE_N_MU] = event->Muon_size;
+    values[ZONE_N_EL] = event->Electron_size;
+    values[ZONE_MET] = event->MissingET_MET[0];
+}
+
+// Entries [first, last) and the range of every key quantity over them
+struct Zone
+{
+    Long64_t first = 0;
+    Long64_t last = 0;
+    Float_t min[ZONE_NKEYS];
+    Float_t max[ZONE_NKEYS];
+
+    void Start(Long64_t entry)
+    {
+        first = entry;
+        last = entry;
+    }
+
+    template <class Event>
+    void Add(Event *event)
+    {
+        Float_t values[ZONE_NKEYS];
+        zone_values(event, values);
+        for (int k=0; k<ZONE_NKEYS; k++)
+        {
+            min[k] = last == first ? values[k] : TMath::Min(min[k], values[k]);
+            max[k] = last == first ? values[k] : TMath::Max(max[k], values[k]);
+        }
+        last++;
+    }
+};
+
+/*
+One requirement "key op value", op one of > >= < <=, e.g. lead_mu_pt>150.
+Several are given comma separated and must all hold. parse_requirements
+sets valid to false if any of them has an unknown key or no number.
+*/
+struct Requirement
+{
+    int key;
+    std::string op;
+    double value;
+
+    bool Pass(double x) const
+    {
+        if (op == ">") return x > value;
+        if (op == ">=") return x >= value;
+        if (op == "<") return x < value;
+        return x <= value;
+    }
+
+    // False only if no event of the zone can pass
+    bool MayPass(const Zone &zone) const
+    {
+        if (op == ">" or op == ">=") return Pass(zone.max[key]);
+        return Pass(zone.min[key]);
+    }
+};
+
+std::vector<Requirement> parse_requirements(const std::string &text, bool &valid)
+{
+    std::vector<Requirement> requirements;
+    valid = true;
+    std::istringstream items(text);
+    std::string item;
+    while (std::getline(items, item, ','))
+    {
+        if (item.empty()) continue;
+        size_t op = item.find_first_of("<>");
+        Requirement requirement;
+        requirement.key = -1;
+        if (op != std::string::npos)
+        {
+            for (int k=0; k<ZONE_NKEYS; k++)
+            {
+                if (item.compare(0, op, ZONE_KEY_NAMES[k]) == 0 and strlen(ZONE_KEY_NAMES[k]) == op) requirement.key = k;
+            }
+            requirement.op = item.substr(op, item[op + 1] == '=' ? 2 : 1);
+            const char *number = item.c_str() + op + requirement.op.size();
+            char *end = nullptr;
+            requirement.value = strtod(number, &end);
+            if (end == number or *end != '\0') requirement.key = -1;
+        }
+        if (requirement.key < 0)
+        {
+            printf("Unknown requirement %s\n", item.c_str());
+            valid = false;
+            continue;
+        }
+        requirements.push_back(requirement);
+    }
+    return requirements;
+}
+
+template <class Event>
+bool pass_requirements(const std::vector<Requirement> &requirements, Event *event)
+{
+    if (requirements.empty()) return true;
+    Float_t values[ZONE_NKEYS];
+    zone_values(event, values);
+    for (const auto &requirement : requirements)
+    {
+        if (!requirement.Pass(values[requirement.key])) return false;
+    }
+    return true;
+}
+
+bool zone_may_pass(const std::vector<Requirement> &requirements, const Zone &zone)
+{
+    for (const auto &requirement : requirements)
+    {
+        if (!requirement.MayPass(zone)) return false;
+    }
+    return true;
+}
+
+void write_zone_map(TFile *outfile, const std::vector<Zone> &zones)
+{
+    outfile->cd();
+    Zone zone;
+    TTree *tree = new TTree(ZONE_TREE_NAME, "per cluster min and max of the key quantities");
+    tree->Branch("first", &zone.first, "first/L");
+    tree->Branch("last", &zone.last, "last/L");
+    tree->Branch("min", zone.min, Form("min[%d]/F", ZONE_NKEYS));
+    tree->Branch("max", zone.max, Form("max[%d]/F", ZONE_NKEYS));
+    for (const auto &z : zones)
+    {
+        zone = z;
+        tree->Fill();
+    }
+    tree->Write();
+    delete tree;
+}
+
+// Returns false if the file has no zone map
+bool read_zone_map(TFile *infile, std::vector<Zone> &zones)
+{
+    TTree *tree = nullptr;
+    infile->GetObject(ZONE_TREE_NAME, tree);
+    if (tree == nullptr) return false;
+    Zone zone;
+    tree->SetBranchAddress("first", &zone.first);
+    tree->SetBranchAddress("last", &zone.last);
+    tree->SetBranchAddress("min", zone.min);
+    tree->SetBranchAddress("max", zone.max);
+    for (Long64_t i=0; i<tree->GetEntries(); i++)
+    {
+        tree->GetEntry(i);
+        zones.push_back(zone);
+    }
+    delete tree;
+    return true;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <TFile.h>
+#include <TTree.h>
+#include "read-fcc-higgs-v3.cpp"
+#include "fcc-higgs-eventindex.h"
+
+using namespace std;
+
+/*
+Finds the file and entry of an Event.Number in an index of
+index-fcc-higgs.cpp, and with the option dump prints the event:
+
+    root -l -b -q "find-event-fcc-higgs.cpp(\"hvqMulti1M.index.root\", 123456, \"dump\")"
+
+The index is sorted by number, so a binary search reads O(log n) of its
+entries; only the number branch is read until the match. Every file
+holding the number is listed, as the numbers of a dataset need not be
+unique across its files.
+*/
+
+void find_event_fcc_higgs(TString indexfilename, Long64_t number, TString options = "")
+{
+    gErrorIgnoreLevel = kFatal;
+    bool dump = options.Contains("dump");
+
+    TFile *index = TFile::Open(indexfilename);
+    TTree *tree = nullptr;
+    vector<string> files;
+    if (index != nullptr and !index->IsZombie()) index->GetObject(EVENT_INDEX_NAME, tree);
+    if (tree == nullptr or !read_event_files(index, files))
+    {
+        printf("Cannot read the index %s\n", indexfilename.Data());
+        delete index;
+        return;
+    }
+
+    EventLocation location;
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus("number", 1);
+    tree->SetBranchAddress("number", &location.number);
+    Long64_t first = 0;
+    Long64_t last = tree->GetEntries();
+    while (first < last)
+    {
+        Long64_t middle = first + (last - first) / 2;
+        tree->GetEntry(middle);
+        if (location.number < number) first = middle + 1;
+        else last = middle;
+    }
+
+    tree->SetBranchStatus("*", 1);
+    tree->SetBranchAddress("file", &location.file);
+    tree->SetBranchAddress("entry", &location.entry);
+    int found = 0;
+    for (Long64_t i=first; i<tree->GetEntries(); i++)
+    {
+        tree->GetEntry(i);
+        if (location.number != number) break;
+        const string &filename = files[location.file];
+        printf("Event %lld: %s entry %lld\n", number, filename.c_str(), location.entry);
+        found++;
+        if (!dump) continue;
+        TFile *infile = TFile::Open(filename.c_str());
+        TTree *events = nullptr;
+        if (infile != nullptr and !infile->IsZombie())
+        {
+            infile->GetObject("Delphes", events);
+            if (events == nullptr) infile->GetObject(FLAT_TREE_NAME, events);
+        }
+        if (events != nullptr) events->Show(location.entry);
+        else printf("Cannot dump %s\n", filename.c_str());
+        delete infile;
+    }
+    if (found == 0) printf("Event %lld is not in %s\n", number, indexfilename.Data());
+    delete index;
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <TStopwatch.h>
+#include "run-fcc-higgs.cpp"
+
+using namespace std;
+
+/*
+Writes the Event.Number index of a dataset (fcc-higgs-eventindex.h): the
+file and entry of every event, sorted by number.
+
+    root -l -b -q "index-fcc-higgs.cpp(\"@hvqMulti1M.txt\", \"hvqMulti1M.index.root\")"
+
+INPUT is a glob, or @list.txt, of Delphes files, flat skims or column
+caches; only their Event.Number is read. find-event-fcc-higgs.cpp looks
+numbers up in the index.
+*/
+
+// Event.Number of every entry of one input, false if unreadable
+bool read_event_numbers(const string &filename, vector<Long64_t> &numbers)
+{
+    if (is_column_cache(filename))
+    {
+        MappedColumns columns(filename);
+        if (!columns.IsValid()) return false;
+        const Long64_t *number = columns.Column<Long64_t>("Event_Number", 'L');
+        if (number == nullptr) return false;
+        numbers.assign(number, number + columns.Entries());
+        return true;
+    }
+
+    TFile *infile = TFile::Open(filename.c_str());
+    if (infile == nullptr or infile->IsZombie())
+    {
+        delete infile;
+        return false;
+    }
+    TTree *tree = nullptr;
+    bool flat = true;
+    infile->GetObject(FLAT_TREE_NAME, tree);
+    if (tree == nullptr)
+    {
+        flat = false;
+        infile->GetObject("Delphes", tree);
+    }
+    const char *branch = flat ? "Event_Number" : "Event.Number";
+    if (tree == nullptr or tree->GetBranch(branch) == nullptr)
+    {
+        delete infile;
+        return false;
+    }
+    Long64_t number[Delphes::kMaxEvent] = {0};
+    tree->SetBranchStatus("*", 0);
+    if (!flat) tree->SetBranchStatus("Event", 1);
+    tree->SetBranchStatus(branch, 1);
+    tree->SetBranchAddress(branch, number);
+    numbers.resize(tree->GetEntries());
+    for (Long64_t i=0; i<tree->GetEntries(); i++)
+    {
+        tree->GetEntry(i);
+        numbers[i] = number[0];
+    }
+    delete infile;
+    return true;
+}
+
+void index_fcc_higgs(TString infilename, TString outfilename)
+{
+    gErrorIgnoreLevel = kFatal;
+
+    TStopwatch timer;
+    timer.Start();
+    vector<string> files;
+    vector<EventLocation> locations;
+    vector<Long64_t> numbers;
+    for (const auto &filename : expand_inputs(infilename))
+    {
+        if (!read_event_numbers(filename, numbers))
+        {
+            printf("Cannot read Event.Number from %s\n", filename.c_str());
+            continue;
+        }
+        printf("%s: %zu events\n", filename.c_str(), numbers.size());
+        for (size_t i=0; i<numbers.size(); i++)
+        {
+            EventLocation location;
+            location.file = files.size();
+            location.entry = i;
+            location.number = numbers[i];
+            locations.push_back(location);
+        }
+        files.push_back(filename);
+    }
+    if (!write_event_index(outfilename, files, locations))
+    {
+        printf("Cannot write %s\n", outfilename.Data());
+        return;
+    }
+    timer.Stop();
+    printf("Indexed %zu events of %zu files in %s, %.2f s\n", locations.size(), files.size(), outfilename.Data(), timer.RealTime());
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <TParameter.h>
+#include <TStopwatch.h>
+#include "run-fcc-higgs.cpp"
+
+using namespace std;
+
+/*
+Fills in the planning columns of a dataset catalogue (fcc-higgs-samples.h):
+entries, bytes, sum of weights and mtime of every input file.
+
+    root -l -b -q "make-catalogue.cpp(\"catalogue.tsv\")"
+
+Lines with a glob or @list.txt as input are expanded to one line per file.
+Only files that are new, or whose size or mtime changed, are opened, and
+only their weight column is read, so refreshing a catalogue after adding a
+production costs a read of the new files only. A file that cannot be read
+keeps its line with -1 columns, so its sample stays unknown and the next
+refresh tries it again, and the macro exits with status 1. pyinterface.py --mode
+catalogue writes the lines from processes.py and then runs this.
+*/
+
+// Entries and sum of the event weights of one input, false if unreadable
+bool read_catalogue_columns(const string &filename, Long64_t &entries, double &sum_weights)
+{
+    if (is_column_cache(filename))
+    {
+        MappedColumns columns(filename);
+        if (!columns.IsValid()) return false;
+        entries = columns.Entries();
+        const Float_t *weights = columns.Column<Float_t>("Event_Weight", 'F');
+        sum_weights = weights == nullptr ? entries : 0;
+        if (weights != nullptr) for (Long64_t i=0; i<entries; i++) sum_weights += weights[i];
+        // Plus the events of the sources left out of it, as the engine counts them
+        for (UInt_t s=0; s<columns.NSources(); s++) sum_weights += columns.Source(s).dropped_weight;
+        return true;
+    }
+
+    TFile *infile = TFile::Open(filename.c_str());
+    if (infile == nullptr or infile->IsZombie())
+    {
+        delete infile;
+        return false;
+    }
+    TTree *tree = nullptr;
+    bool flat = true;
+    infile->GetObject(FLAT_TREE_NAME, tree);
+    if (tree == nullptr)
+    {
+        flat = false;
+        infile->GetObject("Delphes", tree);
+    }
+    if (tree == nullptr)
+    {
+        delete infile;
+        return false;
+    }
+    entries = tree->GetEntries();
+
+    // A skim is normalised with the weights of its whole input
+    TParameter<double> *skim_sum_weights = nullptr;
+    infile->GetObject("skim_input_sum_weights", skim_sum_weights);
+    if (skim_sum_weights != nullptr)
+    {
+        sum_weights = skim_sum_weights->GetVal();
+        delete infile;
+        return true;
+    }
+
+    sum_weights = tree_sum_weights(tree, flat, 0, entries);
+    delete infile;
+    return true;
+}
+
+void make_catalogue(TString catalogue_path)
+{
+    gErrorIgnoreLevel = kFatal;
+
+    DatasetCatalogue catalogue;
+    if (!catalogue.Read(catalogue_path.Data()))
+    {
+        printf("Cannot read %s\n", catalogue_path.Data());
+        return;
+    }
+
+    TStopwatch timer;
+    timer.Start();
+    vector<CatalogueRow> rows;
+    int refreshed = 0;
+    int unreadable = 0;
+    for (const auto &line : catalogue.rows)
+    {
+        for (const auto &filename : expand_inputs(line.input.c_str()))
+        {
+            CatalogueRow row = line;
+            if (filename != line.input)
+            {
+                row.input = filename;
+                row.entries = -1;
+            }
+            if (!row.Known() or !row.Current())
+            {
+                FileStat_t stat;
+                if (gSystem->GetPathInfo(filename.c_str(), stat) != 0 or !read_catalogue_columns(filename, row.entries, row.sum_weights))
+                {
+                    printf("Cannot read %s\n", filename.c_str());
+                    unreadable++;
+                    row.entries = row.bytes = row.mtime = -1;
+                    row.sum_weights = -1;
+                    rows.push_back(row);
+                    continue;
+                }
+                row.bytes = stat.fSize;
+                row.mtime = stat.fMtime;
+                printf("%s: %lld entries, sum of weights %g\n", filename.c_str(), row.entries, row.sum_weights);
+                refreshed++;
+            }
+            rows.push_back(row);
+        }
+    }
+    catalogue.rows = rows;
+    if (!catalogue.Write(catalogue_path.Data()))
+    {
+        printf("Cannot write %s\n", catalogue_path.Data());
+        gSystem->Exit(1);
+    }
+    timer.Stop();
+    printf("%zu files in %s, %d read again, %d unreadable, %.2f s\n", rows.size(), catalogue_path.Data(), refreshed, unreadable, timer.RealTime());
+    if (unreadable > 0) gSystem->Exit(1);
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <TStopwatch.h>
+#include "run-fcc-higgs.cpp"
+
+using namespace std;
+
+/*
+Writes the columns of the selection of INPUT (Delphes files or flat skims,
+glob or @list.txt) into one column cache (fcc-higgs-colcache.h), which the
+engine then reads through mmap without any decompression:
+
+    root -l -b -q "make-column-cache.cpp(\"INPUT\", \"OUTPUT.fcccol\")"
+    root -l -b -q "run-fcc-higgs.cpp(\"OUTPUT.fcccol\", \"hists.root\")"
+
+options:
+    veto    keep only the events passing the lepton veto, as the skimmer
+            does; the weight of the events left out is recorded per source
+            and added to sum_weights by the engine, so the histograms and
+            their normalisation stay the same
+
+The cache is built in memory, so make it from skims rather than from full
+samples.
+*/
+
+void make_column_cache(TString infilename, TString outfilename, TString options = "")
+{
+    gErrorIgnoreLevel = kFatal;
+
+    bool veto = false;
+    istringstream tokens(options.Data());
+    string token;
+    while (tokens >> token)
+    {
+        if (token == "veto") veto = true;
+        else printf("Unknown option %s\n", token.c_str());
+    }
+
+    TStopwatch timer;
+    timer.Start();
+    ColumnCacheWriter writer;
+    Long64_t processed = 0;
+    for (const auto &filename : expand_inputs(infilename))
+    {
+        InputReader reader;
+        if (is_column_cache(filename) or !reader.Open(filename))
+        {
+            printf("Cannot read Delphes tree from %s, skipping\n", filename.c_str());
+            continue;
+        }
+        printf("Reading %s\n", filename.c_str());
+        writer.AddSource(filename, skim_dropped_weight(filename));
+        Long64_t nentries = reader.Entries();
+        reader.Visit([&](auto *event)
+        {
+            for (Long64_t ievent=0; ievent < nentries; ievent++)
+            {
+                if (ievent % 100000 == 0) printf("Reading event %lld\n", ievent);
+                event->GetEntry(ievent);
+                if (veto and !pass_lepton_veto(event))
+                {
+                    writer.Drop(event->Event_Weight[0]);
+                    continue;
+                }
+                writer.Fill(event);
+            }
+            processed += nentries;
+        });
+    }
+
+    if (!writer.Write(outfilename))
+    {
+        printf("Cannot write %s\n", outfilename.Data());
+        return;
+    }
+    timer.Stop();
+    printf("Wrote %lld of %lld events to %s in %.2f s\n", writer.Entries(), processed, outfilename.Data(), timer.RealTime());
+}
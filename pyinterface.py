@@ -5,6 +5,7 @@ import os
 import argparse
 import time
 from processes import BACKGROUND, MUTAU_SIGNAL, ETAU_SIGNAL, PURPLE_ETAU_E, PURPLE_MUTAU_E
+import catalogue
 
 
 # Universal script to submit jobs, monitoring jobs, and post-processing
@@ -37,7 +38,7 @@ def argpass():
         "--mode", type=str, default="job_submit", help="Mode to run the script"
     )
     parser.add_argument(
-        "--process", type=str, default=None, help="Process to run the script"
+        "--process", type=str, default=None, help="Process to run the script, all for every process in one engine run"
     )
     parser.add_argument(
         "--overwrite", action="store_true", help="Overwrite the output directory", default=False
@@ -63,16 +64,43 @@ def argpass():
     parser.add_argument(
         "--minimal", action="store_true", help="Use minimal file", default=False
     )
+    # Keep one ROOT process per CPU alive and feed it files over named pipes
+    parser.add_argument(
+        "--worker", action="store_true", help="Use persistent ROOT workers", default=False
+    )
+    # Single multithreaded ROOT process with work stealing over file chunks
+    parser.add_argument(
+        "--engine", action="store_true", help="Use the multithreaded engine", default=False
+    )
+    # Drop events read twice from files of the same production seed (engine only)
+    parser.add_argument(
+        "--dedup", action="store_true", help="Drop duplicate events in the engine", default=False
+    )
+    # Per-file results keyed on (input checksum, selection, code version);
+    # auto = cache/ next to this script, none = disabled
+    parser.add_argument("--cache", type=str, default="auto", help="Result cache directory")
+    # Dataset catalogue (catalogue.py) with the files, entries and sums of weights
+    # of every process; auto = catalogue.tsv next to this script if it exists,
+    # none = list the directories; --mode catalogue refreshes it
+    parser.add_argument("--catalogue", type=str, default="auto", help="Dataset catalogue")
     
     args = parser.parse_args()
 
     return args
 
 
-def get_files(args) -> list:
+def get_files(args, process=None, scan=False) -> list:
 
-    if args.minimal: path = ALL_PROCESSES[args.process]["minimal"]
-    else: path = ALL_PROCESSES[args.process]["path"]
+    process = process or args.process
+    if process == "all":
+        return [f for name in ALL_PROCESSES for f in get_files(args, name, scan)]
+    # Listed in the catalogue, no need to list the directories again
+    if not scan and not args.minimal and args.catalogue not in ["auto", "none"]:
+        files = catalogue.files_of(catalogue.read_catalogue(args.catalogue), process)
+        if files:
+            return files
+    if args.minimal: path = ALL_PROCESSES[process]["minimal"]
+    else: path = ALL_PROCESSES[process]["path"]
     files = []
     mapped = [path] if isinstance(path, str) else path  # Mapped to list
     for element in mapped:
@@ -89,7 +117,8 @@ def get_files(args) -> list:
 def job_submit(args):
     def validate_args(args):
         
-        assert args.process in ALL_PROCESSES.keys(), f"Process {args.process} is not available"
+        assert args.process in ALL_PROCESSES.keys() or args.process == "all", f"Process {args.process} is not available"
+        assert args.process != "all" or args.engine, "--process all needs --engine"
 
         outdir = args.outdir
         if outdir == "auto":
@@ -107,6 +136,10 @@ def job_submit(args):
                 sys.exit(1)
 
         args.outdir = outdir
+        if args.cache == "auto":
+            args.cache = os.path.abspath("cache")
+        if args.catalogue == "auto":
+            args.catalogue = os.path.abspath("catalogue.tsv") if os.path.exists("catalogue.tsv") else "none"
         files = get_files(args)
 
         if args.ncpus == -1:
@@ -137,6 +170,11 @@ def job_submit(args):
         )
         
         if args.minimal: slurm_script += " --minimal"
+        if args.worker: slurm_script += " --worker"
+        if args.engine: slurm_script += " --engine"
+        if args.dedup: slurm_script += " --dedup"
+        slurm_script += f" --cache {args.cache}"
+        slurm_script += f" --catalogue {args.catalogue}"
 
         return slurm_script
 
@@ -145,12 +183,16 @@ def job_submit(args):
         outdir = args.outdir
         os.makedirs(outdir)
 
-        script_files = ["Delphes.C", "Delphes.h", "read-fcc-higgs-v2.cpp", "read-fcc-higgs-v3.cpp"]
+        script_files = ["Delphes.C", "Delphes.h", "read-fcc-higgs-v2.cpp", "read-fcc-higgs-v3.cpp", "fcc-higgs-worker.cpp",
+                        "fcc-higgs-scheduler.h", "fcc-higgs-checkpoint.h", "fcc-higgs-flat.h", "fcc-higgs-colcache.h", "fcc-higgs-zonemap.h",
+                        "fcc-higgs-decisions.h", "fcc-higgs-friend.h", "fcc-higgs-unbinned.h", "fcc-higgs-common.h",
+                        "fcc-higgs-universes.h", "fcc-higgs-bootstrap.h", "fcc-higgs-samples.h", "fcc-higgs-dedup.h", "fcc-higgs-eventindex.h", "fcc-higgs-metrics.h", "run-fcc-higgs.cpp", "make-catalogue.cpp"]
         for script_file in script_files:
             os.system(f"cp {script_file} {outdir}")
 
         os.system(f"cp pyinterface.py {outdir}")
         os.system(f"cp processes.py {outdir}")
+        os.system(f"cp catalogue.py {outdir}")
 
         # Write the SLURM script
         slurm_script = construct_slurm_script(args)
@@ -198,13 +240,14 @@ def post_process(args):
     def get_max_njet():
         # Get the max number of jets from the files
         files = [f for f in os.listdir() if (f.endswith(".root") and f != "merged.root")]
-        file = files[0]
-        file = ROOT.TFile(file)
-        keys = file.GetListOfKeys()
-        hist_names = [key.GetName() for key in keys if "etau_mu_highmass" in key.GetName()]
-        njets = [int(name.split("_")[-1][0]) for name in hist_names]
-        max_njet = max(njets)
-        return max_njet
+        for file in files:
+            file = ROOT.TFile(file)
+            keys = file.GetListOfKeys()
+            hist_names = [key.GetName() for key in keys if "etau_mu_highmass" in key.GetName()]
+            njets = [int(name.split("_")[-1][0]) for name in hist_names]
+            if njets:
+                return max(njets)
+        raise ValueError("No histogram output found")
         
 
     # list for printing cut flow
@@ -258,6 +301,9 @@ def post_process(args):
 
         keys = file.GetListOfKeys()
         for key in keys:
+            # Only histograms, not the unbinned events or other side outputs
+            if not ROOT.TClass.GetClass(key.GetClassName()).InheritsFrom("TH1"):
+                continue
             hist = key.ReadObj()
             name = hist.GetName()
             if name not in hist_dicts:
@@ -276,6 +322,14 @@ def post_process(args):
     for key, hist in hist_dicts.items():
         hist.Write()
 
+    # Unbinned events of the final categories, for rebin-fcc-higgs.cpp
+    selected = ROOT.TChain("selected_events")
+    for f in files:
+        selected.Add(f)
+    if selected.GetEntries() > 0:
+        output.cd()
+        selected.CloneTree(-1, "fast").Write()
+
     # Print cut flow,
     # N_event of each step, pct change from previous step, desc
     print("\nCut flow")
@@ -294,8 +348,19 @@ def post_process(args):
 
 
     # ================== Weighting ==================
-    tot_evts = hist_dicts["mutau_e_step00"].GetEntries()
-    print(f"\nComputing scale factor with total events: {tot_evts}")
+    # Sum of the event weights of all processed events; outputs without
+    # sum_weights (v2, older v3) fall back to the sum of weights of the first
+    # step, which is the count of events where it was filled unweighted
+    if "sum_weights" in hist_dicts:
+        sum_weights = hist_dicts["sum_weights"]
+        tot_evts = sum_weights.GetBinContent(1)
+        print(f"\nComputing scale factor with sum of weights: {tot_evts} "
+              f"(sum of squares {sum_weights.GetSumw2().At(1)}, {int(sum_weights.GetEntries())} events, "
+              f"effective {sum_weights.GetEffectiveEntries():.1f})")
+    else:
+        step00 = hist_dicts["mutau_e_step00"]
+        tot_evts = step00.Integral(0, step00.GetNbinsX() + 1)
+        print(f"\nComputing scale factor with total events: {tot_evts}")
     process = args.process
     if process is None:
         import pandas as pd
@@ -303,7 +368,14 @@ def post_process(args):
         df = pd.read_csv("info.csv")
         process = df["process"].unique()[0]
         print(f"Process: {process}")
-        
+
+    # A complete catalogue normalises without depending on which events were read
+    if args.catalogue not in ["auto", "none"]:
+        totals = catalogue.sample_totals(catalogue.read_catalogue(args.catalogue), process)
+        if totals is not None:
+            tot_evts = totals[1]
+            print(f"\tSum of weights from {args.catalogue}: {tot_evts} ({totals[0]} entries)")
+
     cross_section = ALL_PROCESSES[process]["cross-section"]
     target_lumi = 30 # ab^-1
     target_lumi_pb = target_lumi * 1e6 # pb^-1
@@ -321,34 +393,441 @@ def post_process(args):
 
     output.Close()
 
+# Bookkeeping of finished files: every process appends to records/{pid}.tsv
+RECORDS_DIR = "records"
+RECORD_COLUMNS = ["file", "out_file", "time_taken", "status", "finished"]
+
+
+def append_record(record, directory=RECORDS_DIR):
+    """
+    Append record (a dict with RECORD_COLUMNS) as one line to the record file
+    of this process. No two processes share a file, so none ever waits on
+    another and no update is lost; read_records() puts them together.
+    """
+    os.makedirs(directory, exist_ok=True)
+    line = "\t".join(str(record[column]) for column in RECORD_COLUMNS) + "\n"
+    with open(f"{directory}/{os.getpid()}.tsv", "a") as f:
+        f.write(line)
+
+
+def read_records(directory=RECORDS_DIR):
+    """The records of all processes, a list of dicts, complete lines only."""
+    records = []
+    if not os.path.isdir(directory):
+        return records
+    for name in sorted(os.listdir(directory)):
+        with open(f"{directory}/{name}") as f:
+            for line in f:
+                fields = line.rstrip("\n").split("\t")
+                if not line.endswith("\n") or len(fields) != len(RECORD_COLUMNS):
+                    continue
+                record = dict(zip(RECORD_COLUMNS, fields))
+                record["time_taken"] = float(record["time_taken"])
+                record["status"] = int(record["status"])
+                records.append(record)
+    return records
+
+
 def run_cut(file, out_file):
     command = (
         f'root -l -b -q "read-fcc-higgs-v3.cpp(\\"{file}\\", \\"{out_file}\\")" > log_{out_file}.txt 2>&1'
     )
     start_time = time.time()
-    os.system(command)
+    status = os.system(command)
     end_time = time.time()
     time_taken = end_time - start_time
-    
-    # Experiment, open info.csv and get the line with column file == file
-    # Update the time_taken column with the time_taken
+
+    append_record({"file": file, "out_file": out_file, "time_taken": f"{time_taken:.3f}", "status": status, "finished": f"{end_time:.0f}"})
+    return {"file": file, "time_taken": time_taken, "status": status}
+
+
+# Times a worker is started for one file, or in a row without starting
+WORKER_ATTEMPTS = 3
+
+
+def run_workers(tasks, ncpus):
+    """
+    Process (file, out_file) pairs with ncpus persistent ROOT workers
+    (fcc-higgs-worker.cpp). Each worker pays the ROOT start-up once and is
+    handed the next file as soon as it reports the previous one done, so
+    the per-file cost is only the event loop itself.
+    Returns a list of {"file", "time_taken", "status"} like run_cut, status
+    0 if the worker reported the file done.
+
+    A worker that dies is restarted and its file handed out again, up to
+    WORKER_ATTEMPTS times per file; a file that kills every attempt counts
+    as failed. Raises RuntimeError with the files left unprocessed if no
+    worker could be (re)started to run them.
+    """
+    import queue
+    import subprocess
+    import threading
+
+    todo = queue.Queue()
+    for file, out_file in tasks:
+        todo.put((file, out_file))
+    results = []
+    results_lock = threading.Lock()
+    attempts = {}
+
+    def open_for_write(pipe, proc):
+        # Opening a fifo for writing blocks until the reader shows up,
+        # poll instead so a worker that dies at start-up does not hang us
+        while True:
+            try:
+                fd = os.open(pipe, os.O_WRONLY | os.O_NONBLOCK)
+                os.set_blocking(fd, True)
+                return os.fdopen(fd, "w")
+            except OSError:
+                if proc.poll() is not None:
+                    return None
+                time.sleep(0.1)
+
+    def serve(n):
+        inpipe, outpipe = f"worker_{n}.in", f"worker_{n}.out"
+        for pipe in [inpipe, outpipe]:
+            if os.path.exists(pipe):
+                os.remove(pipe)
+            os.mkfifo(pipe)
+
+        failed_starts = 0
+        with open(f"log_worker_{n}.txt", "w") as log:
+            # (Re)start the worker as long as there are files for it
+            while not todo.empty() and failed_starts < WORKER_ATTEMPTS:
+                proc = subprocess.Popen(
+                    ["root", "-l", "-b", "-q", f'fcc-higgs-worker.cpp("{inpipe}", "{outpipe}")'],
+                    stdout=log, stderr=subprocess.STDOUT,
+                )
+                fin = open_for_write(inpipe, proc)
+                if fin is None:
+                    print(f"Worker {n} failed to start, see log_worker_{n}.txt")
+                    failed_starts += 1
+                    continue
+                failed_starts = 0
+                died = False
+                with fin, open(outpipe, "r") as fout:
+                    while True:
+                        try:
+                            file, out_file = todo.get_nowait()
+                        except queue.Empty:
+                            break
+                        start_time = time.time()
+                        fin.write(f"{file} {out_file}\n")
+                        fin.flush()
+                        reply = fout.readline().split()
+                        time_taken = time.time() - start_time
+                        if len(reply) == 0:
+                            died = True
+                            with results_lock:
+                                attempts[file] = attempts.get(file, 0) + 1
+                                retry = attempts[file] < WORKER_ATTEMPTS
+                                if not retry:
+                                    results.append({"file": file, "time_taken": time_taken, "status": 1})
+                            print(f"Worker {n} died while processing {file}, " + ("restarting it" if retry else "giving the file up"))
+                            if retry:
+                                todo.put((file, out_file))
+                            break
+                        if reply[0] != "done":
+                            print(f"Worker {n} could not process {file}")
+                        with results_lock:
+                            results.append({"file": file, "time_taken": time_taken, "status": 0 if reply[0] == "done" else 1})
+                    try:
+                        fin.write("quit\n")
+                    except BrokenPipeError:
+                        pass
+                proc.wait()
+                if not died:
+                    break
+
+        for pipe in [inpipe, outpipe]:
+            os.remove(pipe)
+
+    threads = [threading.Thread(target=serve, args=(n,)) for n in range(ncpus)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    left = []
+    while not todo.empty():
+        left.append(todo.get_nowait()[0])
+    if left:
+        raise RuntimeError(f"No worker left to process {len(left)} files: " + ", ".join(left))
+
+    return results
+
+
+def read_metrics(path):
+    """The live metrics of an engine run (fcc-higgs-metrics.h), None if not written yet."""
+    import json
+    try:
+        with open(path) as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return None
+
+
+def read_chunk_records(out_file):
+    """
+    Sum the per-thread chunk records {out_file}.chunks.W.tsv of a running
+    engine: {thread: {"chunks", "entries", "seconds", "selected"}}, complete lines only.
+    """
+    import glob
+
+    threads = {}
+    for path in glob.glob(f"{out_file}.chunks.*.tsv"):
+        with open(path) as f:
+            header = f.readline().rstrip("\n").split("\t")
+            for line in f:
+                fields = line.rstrip("\n").split("\t")
+                if not line.endswith("\n") or len(fields) != len(header):
+                    continue
+                row = dict(zip(header, fields))
+                totals = threads.setdefault(int(row["thread"]), {"chunks": 0, "entries": 0, "seconds": 0.0, "selected": 0})
+                totals["chunks"] += 1
+                totals["entries"] += int(row["entries"])
+                totals["seconds"] += float(row["seconds"])
+                totals["selected"] += int(row["selected"])
+    return threads
+
+
+def run_monitored(command, out_file, interval=60, stuck_after=600):
+    """
+    Run an engine command writing out_file, printing its live metrics
+    ({out_file}.metrics.json) and the sums of the chunk records of its
+    threads every interval seconds, and naming the threads that have not
+    finished a chunk for stuck_after seconds.
+    The timing and metrics of an earlier run are removed first, and a failed
+    run raises with its log, log_{out_file}.txt, so no stale result is read.
+    """
+    import subprocess
+
+    metrics_path = f"{out_file}.metrics.json"
+    for stale in [f"{out_file}.timing.tsv", metrics_path]:
+        if os.path.exists(stale):
+            os.remove(stale)
+    proc = subprocess.Popen(command, shell=True)
+    while True:
+        try:
+            proc.wait(timeout=interval)
+            break
+        except subprocess.TimeoutExpired:
+            pass
+        threads = read_chunk_records(out_file)
+        if threads:
+            entries = sum(totals["entries"] for totals in threads.values())
+            selected = sum(totals["selected"] for totals in threads.values())
+            print(f"{sum(totals['chunks'] for totals in threads.values())} chunks, {entries} events, {selected} selected")
+            for w, totals in sorted(threads.items()):
+                print(f"\tthread {w}: {totals['chunks']} chunks, {totals['entries']} events in {totals['seconds']:.0f} s, {totals['selected']} selected")
+        metrics = read_metrics(metrics_path)
+        if metrics is None:
+            continue
+        eta = time.strftime("%H:%M:%S", time.gmtime(max(metrics["eta"], 0)))
+        print(f"{metrics['processed']} / {metrics['total']} events, {metrics['events_per_s']:.1f} events/s, "
+              f"{metrics['bytes_read'] / 1e9:.2f} GB read in {metrics['read_seconds']:.0f} thread-s, "
+              f"RSS {metrics['rss_kb'] / 1e6:.2f} GB, ETA {eta}")
+        stuck = [w for w, thread in enumerate(metrics["threads"]) if thread["running"] and thread["since_last_chunk"] > stuck_after]
+        if stuck:
+            print(f"\tThreads without a finished chunk for {stuck_after} s: {stuck}")
+    if proc.returncode != 0:
+        raise RuntimeError(f"Engine run for {out_file} failed with exit code {proc.returncode}, see log_{out_file}.txt")
+    return proc.returncode
+
+
+def run_engine(df, process, ncpus, dedup=False):
+    """
+    Process every file of df in one run-fcc-higgs.cpp job with ncpus threads.
+    The engine splits the files into cluster-aligned chunks and balances them
+    over the threads itself; the per-file thread time comes back through
+    {out_file}.timing.tsv. Returns a list of {"file", "time_taken"} like run_cut.
+    With dedup, events read twice are dropped and listed in {out_file}.duplicates.tsv.
+    Progress is printed from {out_file}.metrics.json while it runs.
+    The engine checkpoints every 5 minutes; if a checkpoint is left over from
+    a killed job, the rerun continues from it.
+    """
     import pandas as pd
-    import random
-    # To avoid conflict with the other processes, create info.status.reading to indicate the file is being read
-    while os.path.exists("info.status.reading"):
-        # Random sleep 1-2 seconds
-        rnd = random.uniform(1, 2)
-        time.sleep(rnd)
-    os.system("touch info.status.reading")
-    df = pd.read_csv("info.csv")
-    df.loc[df["file"] == file, "time_taken"] = time_taken
-    df.to_csv("info.csv", index=False)
-    os.system("rm info.status.reading")
-    
-    return {"file": file, "time_taken": time_taken}
+
+    out_file = f"{process}_engine.root"
+    options = f"threads={ncpus} checkpoint=300"
+    if dedup: options += " dedup"
+    if os.path.exists(f"{out_file}.checkpoint"):
+        print(f"Resuming from {out_file}.checkpoint")
+        options += " resume"
+    with open("files.txt", "w") as f:
+        for file in df["file"]:
+            f.write(f"{file}\n")
+
+    command = (
+        f'root -l -b -q "run-fcc-higgs.cpp(\\"@files.txt\\", \\"{out_file}\\", \\"{options}\\")" > log_{out_file}.txt 2>&1'
+    )
+    run_monitored(command, out_file)
+
+    timing = pd.read_csv(f"{out_file}.timing.tsv", sep="\t")
+    return [{"file": row["file"], "time_taken": row["seconds"]} for _, row in timing.iterrows()]
+
+
+def write_sample_catalogue(args, path="samples.tsv"):
+    """
+    Write every process of processes.py, with its cross-section and files,
+    to path as the sample catalogue of run-fcc-higgs.cpp (fcc-higgs-samples.h).
+    """
+    with open(path, "w") as f:
+        f.write("# sample\tcross-section [pb]\tinput\n")
+        for process, info in ALL_PROCESSES.items():
+            production = info["minimal"] if args.minimal else info["path"]
+            for file in get_files(args, process):
+                sample = catalogue.component_name(process, production, file)
+                f.write(f"{sample}\t{info['cross-section']}\t{file}\n")
+    return path
+
+
+def update_catalogue(args):
+    """
+    Refresh the dataset catalogue from processes.py, listing every directory
+    once, then let make-catalogue.cpp read the entries and sums of weights of
+    the new or changed files only.
+    """
+    path = args.catalogue if args.catalogue not in ["auto", "none"] else os.path.abspath("catalogue.tsv")
+    pending = catalogue.refresh_catalogue(ALL_PROCESSES, lambda name: get_files(args, name, scan=True), path)
+    print(f"Catalogue {path}: {len(pending)} new or changed files")
+    if pending and os.system(f'root -l -b -q "make-catalogue.cpp(\\"{path}\\")"') != 0:
+        print(f"Catalogue {path}: some files could not be read, their samples stay unknown until they are")
+
+
+def run_catalogue(args, ncpus):
+    """
+    Process all samples of processes.py in one run-fcc-higgs.cpp job: the
+    chunks of all samples share the threads, and every sample ends up scaled
+    to 30 ab^-1 in its own directory of all_engine.root, so no post_process
+    is needed. The dataset catalogue is passed as it is, so its sums of
+    weights normalise the samples.
+    """
+    out_file = "all_engine.root"
+    if args.catalogue not in ["auto", "none"] and not args.minimal:
+        catalogue = args.catalogue
+    else:
+        catalogue = write_sample_catalogue(args)
+    options = f"threads={ncpus} checkpoint=300 catalogue"
+    if args.dedup: options += " dedup"
+    if os.path.exists(f"{out_file}.checkpoint"):
+        print(f"Resuming from {out_file}.checkpoint")
+        options += " resume"
+    command = (
+        f'root -l -b -q "run-fcc-higgs.cpp(\\"{catalogue}\\", \\"{out_file}\\", \\"{options}\\")" > log_{out_file}.txt 2>&1'
+    )
+    start_time = time.time()
+    run_monitored(command, out_file)
+    print(f"All samples done in {time.time() - start_time:.2f} s, see {out_file}")
+
+
+# Files the per-file histograms depend on, i.e. the code version of the cache key:
+# the macro and the worker that produce them, and everything they include
+SELECTION_FILES = ["Delphes.C", "Delphes.h", "read-fcc-higgs-v3.cpp", "fcc-higgs-worker.cpp", "fcc-higgs-common.h", "fcc-higgs-checkpoint.h", "fcc-higgs-flat.h",
+                   "fcc-higgs-decisions.h", "fcc-higgs-friend.h", "fcc-higgs-unbinned.h", "fcc-higgs-bootstrap.h", "fcc-higgs-dedup.h"]
+SELECTION_CONFIG = "read_fcc_higgs_v3()"
+
+
+class ResultCache:
+    """
+    Per-file result cache shared by all jobs.
+    An output is stored as {cache_dir}/{key}.root, where key is the sha1 of
+    the input file checksum, the selection configuration and the contents
+    of SELECTION_FILES, so a changed input, selection or macro is simply a
+    miss. Input checksums are memoised in {cache_dir}/checksums.tsv by
+    (path, size, mtime), so unchanged files are not read again.
+    """
+
+    def __init__(self, cache_dir, config=SELECTION_CONFIG):
+        import hashlib
+
+        self.cache_dir = cache_dir
+        os.makedirs(cache_dir, exist_ok=True)
+        self.memo_file = f"{cache_dir}/checksums.tsv"
+        self.memo = {}
+        if os.path.exists(self.memo_file):
+            with open(self.memo_file) as f:
+                for line in f:
+                    fields = line.rstrip("\n").split("\t")
+                    if len(fields) == 3:
+                        self.memo[fields[0]] = (fields[1], fields[2])
+
+        code = hashlib.sha1(config.encode())
+        for script_file in SELECTION_FILES:
+            with open(script_file, "rb") as f:
+                code.update(f.read())
+        self.code_hash = code.hexdigest()
+
+    @staticmethod
+    def stamp(file):
+        st = os.stat(file)
+        return f"{st.st_size}:{st.st_mtime_ns}"
+
+    @staticmethod
+    def checksum(file):
+        import hashlib
+
+        h = hashlib.sha1()
+        with open(file, "rb") as f:
+            for block in iter(lambda: f.read(1 << 24), b""):
+                h.update(block)
+        return h.hexdigest()
+
+    def keys(self, files, nthreads=8):
+        """Cache key of every file, hashing only the ones not in the memo"""
+        import hashlib
+        from concurrent.futures import ThreadPoolExecutor
+
+        stamps = {file: self.stamp(file) for file in files}
+        todo = [file for file in files if self.memo.get(file, (None,))[0] != stamps[file]]
+        if len(todo) > 0:
+            print(f"Computing checksums of {len(todo)} files")
+            with ThreadPoolExecutor(nthreads) as pool:
+                for file, checksum in zip(todo, pool.map(self.checksum, todo)):
+                    self.memo[file] = (stamps[file], checksum)
+            tmp = f"{self.memo_file}.{os.getpid()}.tmp"
+            with open(tmp, "w") as f:
+                for file, (stamp, checksum) in self.memo.items():
+                    f.write(f"{file}\t{stamp}\t{checksum}\n")
+            os.replace(tmp, self.memo_file)
+
+        return {
+            file: hashlib.sha1(f"{self.memo[file][1]} {self.code_hash}".encode()).hexdigest()
+            for file in files
+        }
+
+    def fetch(self, key, out_file):
+        """Copy the cached output to out_file, returns False on a miss"""
+        import shutil
+
+        cached = f"{self.cache_dir}/{key}.root"
+        if not os.path.exists(cached):
+            return False
+        shutil.copyfile(cached, out_file)
+        return True
+
+    def store(self, key, out_file):
+        """Keep out_file under key, unless it does not open cleanly"""
+        import shutil
+        import ROOT
+
+        if not os.path.exists(out_file):
+            return
+        # A crashed or killed run can leave a truncated file ROOT recovers
+        infile = ROOT.TFile.Open(out_file)
+        valid = infile and not infile.IsZombie() and not infile.TestBit(ROOT.TFile.kRecovered)
+        if infile:
+            infile.Close()
+        if not valid:
+            print(f"Not caching {out_file}, it does not open cleanly")
+            return
+        tmp = f"{self.cache_dir}/{key}.root.{os.getpid()}.tmp"
+        shutil.copyfile(out_file, tmp)
+        os.replace(tmp, f"{self.cache_dir}/{key}.root")
 
 
 def job_monitor(args):
+    import shutil
     from multiprocessing import Pool
     import pandas as pd
     import ROOT
@@ -392,6 +871,10 @@ def job_monitor(args):
     ncpus = get_cpu_usage()
     print(f"Used CPUs: {ncpus}")
 
+    if args.process == "all":
+        run_catalogue(args, ncpus)
+        return
+
     process = args.process
     files = get_files(args)
     print(f"List of files ({len(files)}):")
@@ -405,16 +888,51 @@ def job_monitor(args):
     }
     df = pd.DataFrame(pre_df)
     df.to_csv("info.csv", index=False)
+    # Records of an earlier attempt are about files that will run again
+    shutil.rmtree(RECORDS_DIR, ignore_errors=True)
 
     start_time = time.time()
-    with Pool(ncpus) as p:
-        out_dict = p.starmap(run_cut, df[["file", "out_file"]].values)
 
-        for out in out_dict:
-            file = out["file"]
-            df.loc[df["file"] == file, "time_taken"] = out["time_taken"]
+    # Serve unchanged files from the cache, only the rest is processed
+    cache = None
+    todo = df
+    if args.cache not in ["auto", "none"]:
+        cache = ResultCache(args.cache)
+        cache_keys = cache.keys(list(df["file"]), ncpus)
+        hits = [cache.fetch(cache_keys[file], out_file) for file, out_file in df[["file", "out_file"]].values]
+        todo = df[[not hit for hit in hits]]
+        print(f"Cache: {sum(hits)} files from {args.cache}, {len(todo)} to process")
+
+    if len(todo) == 0:
+        out_dict = []
+    elif args.engine:
+        out_dict = run_engine(todo, process, ncpus, args.dedup)
+    elif args.worker:
+        out_dict = run_workers(todo[["file", "out_file"]].values, ncpus)
+    else:
+        with Pool(ncpus) as p:
+            result = p.starmap_async(run_cut, todo[["file", "out_file"]].values)
+            # Progress from the records the workers append, no log parsing
+            while not result.ready():
+                result.wait(60)
+                records = read_records()
+                failed = sum(record["status"] != 0 for record in records)
+                print(f"{len(records)} / {len(todo)} files done ({failed} failed), {sum(record['time_taken'] for record in records):.0f} thread-s")
+            out_dict = result.get()
+
+    # The engine merges all files into one output, so there is nothing per
+    # file to keep; a failed run may have left a partial output behind
+    if cache is not None and not args.engine:
+        succeeded = {out["file"] for out in out_dict if out["status"] == 0}
+        for file, out_file in todo[["file", "out_file"]].values:
+            if file in succeeded:
+                cache.store(cache_keys[file], out_file)
+
+    for out in out_dict:
+        file = out["file"]
+        df.loc[df["file"] == file, "time_taken"] = out["time_taken"]
 
-        df.to_csv("info.csv", index=False)
+    df.to_csv("info.csv", index=False)
     tot_time = time.time() - start_time
     print("Done")
 
@@ -443,6 +961,8 @@ if __name__ == "__main__":
             job_monitor(args)
         elif args.mode == "post_process":
             post_process(args)
+        elif args.mode == "catalogue":
+            update_catalogue(args)
         else:
             print("Invalid mode")
             sys.exit(1)
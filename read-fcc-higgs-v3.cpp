@@ -1,12 +1,20 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include "Delphes.C"
 #include <TMath.h>
 #include <TTree.h>
-#include <glob.h>
 #include <TError.h>
 #include <vector>
+#include <algorithm>
+#include <sstream>
 #include <TString.h>
+#include <TParameter.h>
+#include "fcc-higgs-common.h"
+#include "fcc-higgs-checkpoint.h"
+#include "fcc-higgs-flat.h"
+#include "fcc-higgs-decisions.h"
+#include "fcc-higgs-friend.h"
+#include "fcc-higgs-unbinned.h"
+#include "fcc-higgs-dedup.h"
 
 using namespace std;
 
@@ -15,137 +23,156 @@ const double HIST_START = 0;
 const double HIST_END   = 1500;
 const int MAX_JETS = 2;
 
-std::vector<std::string> glob(const char *pattern) {
-    glob_t g;
-    glob(pattern, GLOB_TILDE, nullptr, &g); // one should ensure glob returns 0!
-    std::vector<std::string> filelist;
-    filelist.reserve(g.gl_pathc);
-    for (size_t i = 0; i < g.gl_pathc; ++i) {
-        filelist.emplace_back(g.gl_pathv[i]);
-    }
-    globfree(&g);
-    return filelist;
-}
-
-Float_t deltaPhi(Float_t phi1, Float_t phi2)
+/*
+Regions the v3 cut flow runs in. The signal region vetoes b-jets and keeps
+0 to MAX_JETS jets and an opposite-sign e mu pair; each control region
+changes one of these. A region books the same histogram names, so every
+region but the signal one is saved in a directory of its own (name).
+*/
+struct Region
 {
-    Float_t dphi = phi1 - phi2;
-    while (dphi >  TMath::Pi()) dphi -= 2*TMath::Pi();
-    while (dphi < -TMath::Pi()) dphi += 2*TMath::Pi();
-    return TMath::Abs(dphi);
-}
-
+    const char *name;
+    bool require_bjet;  // at least one b-jet instead of none
+    bool same_sign;     // same-sign e mu pair instead of opposite-sign
+    int min_jets;       // the jet bins are min_jets, min_jets + 1, ...
+    int n_jet_bins;
+    bool open_ended;    // the last jet bin also takes all higher jet counts
+};
+const Region SIGNAL_REGION = {"signal", false, false, 0, MAX_JETS + 1, false};
+const vector<Region> CONTROL_REGIONS = {
+    {"cr_same_sign", false, true, 0, MAX_JETS + 1, false},
+    {"cr_bjet", true, false, 0, MAX_JETS + 1, false},
+    {"cr_3jet", false, false, MAX_JETS + 1, 1, true},
+};
 
-vector<int> find_ele(Delphes *indelphes, double ptcut, int muon_index)
+void add_hist_shorthand(PlotSet *plots, TString histname, TString propername, vector<int> *histvector)
 {
-    vector<int> res;
-    for (int e=0; e<indelphes->Electron_size; e++)
-    {
-        if (indelphes->Electron_PT[e] < ptcut) continue;
-        if (TMath::Abs(indelphes->Electron_Eta[e]) > 6.0) continue;
-        //if (TMath::Abs(indelphes->Electron_Eta[e]) > 1.44 && TMath::Abs(indelphes->Electron_Eta[e]) < 1.57) continue;
-        //if (indelphes->Electron_IsolationVar[e] < 0.1) continue;
-        if (muon_index != -1)
-        {
-            double deltaR = 0;
-            deltaR += TMath::Power((indelphes->Electron_Eta[e] - indelphes->Muon_Eta[muon_index]), 2);
-            deltaR += TMath::Power((indelphes->Electron_Phi[e] - indelphes->Muon_Phi[muon_index]), 2);
-            deltaR = TMath::Sqrt(deltaR);
-            if (deltaR < 0.3) continue;
-            if (indelphes->Electron_Charge[e] == indelphes->Muon_Charge[muon_index]) continue;
-        }
-        res.push_back(e);
-    }
-    return res;
+    int num = plots->AddHist(new TH1D(histname, propername, HIST_BINS, HIST_START, HIST_END));
+    histvector->push_back(num);
 }
 
-vector<int> find_mu(Delphes *indelphes, double ptcut, int electron_index)
+template <class Event>
+bool pass_lepton_veto(Event *indelphes)
 {
-    vector<int> res;
+    // Loop to filter lepton
+    // muon > 10 GeV, electron > 5 GeV
+    // any event with additional lepton (after filter) is discarded
+    // only exactly one muon and one electron is allowed
+    // logic: loop through muons and electrons, count number of candidates with pT > threshold
+    // if more than one candidate is found, skip the event
+    int muon_count = 0;
     for (int mu=0; mu<indelphes->Muon_size; mu++)
     {
-        if (indelphes->Muon_PT[mu] < ptcut) continue;
+        if (indelphes->Muon_PT[mu] < 10) continue;
         if (TMath::Abs(indelphes->Muon_Eta[mu]) > 6.0) continue;
-        //if (indelphes->Muon_IsolationVar[mu] > 0.15) continue;
-
-        if (electron_index != -1)
-        {
-            double deltaR = 0;
-            deltaR += TMath::Power((indelphes->Muon_Eta[mu] - indelphes->Electron_Eta[electron_index]), 2);
-            deltaR += TMath::Power((indelphes->Muon_Phi[mu] - indelphes->Electron_Phi[electron_index]), 2);
-            deltaR = TMath::Sqrt(deltaR);
-            if (deltaR < 0.3) continue;
-            if (indelphes->Muon_Charge[mu] == indelphes->Electron_Charge[electron_index]) continue;
-        }
-        res.push_back(mu);
+        muon_count++;
     }
-    return res;
+    if (muon_count != 1) return false;
+    int electron_count = 0;
+    for (int el=0; el<indelphes->Electron_size; el++)
+    {
+        if (indelphes->Electron_PT[el] < 5) continue;
+        if (TMath::Abs(indelphes->Electron_Eta[el]) > 6.0) continue;
+        electron_count++;
+    }
+    return electron_count == 1;
 }
 
-class PlotSet
+/*
+SelectionV3 holds the histograms and the per-event cut flow of the v3 
+selection, so the same object can be fed events from any number of 
+files (or entry ranges) before being saved. Reset() clears the 
+histograms without rebooking them.
+*/
+class SelectionV3
 {
     public:
-        PlotSet() { }
-        int AddHist(TH1D* hist)
-        {
-            histograms.push_back(hist);
-            return histograms.size() - 1;
-        }
-        void SaveAll(TFile *outfile)
-        {
-            outfile->cd();
-            for (TH1* hist: histograms) hist->Write();
-        }
-        void PrimeFill(double *value)
-        {
-            primed_variable = value;
-        }
-        void Fill(int histnum)
-        {
-            if (histnum < histograms.size()) histograms[histnum]->Fill(*primed_variable);
-        }
-        vector<TH1*> histograms;
+        SelectionV3(const Region &region = SIGNAL_REGION);
+        SelectionV3(const SelectionV3 &) = delete;
+        ~SelectionV3() { delete bootstrap; }
+        // Event is the Delphes reader or FlatEvent, source that of its file
+        // (dedup_source), which seeds the bootstrap weights
+        template <class Event>
+        void Process(Event *indelphes, ULong64_t source = 0);
+        // The same, with the object stage shared with other selections
+        template <class Event>
+        void Process(Event *indelphes, EventObjects &objects, ULong64_t source = 0);
+        void Reset();
+        void Add(const SelectionV3 &other);
+        // Scales the histograms and the selected events, not sum_weights
+        void Scale(double factor);
+        void SaveAll(TDirectory *outfile);
+        void LoadAll(TDirectory *infile);
+
+        // Decisions of the last processed event (fcc-higgs-decisions.h)
+        bool PassedVeto() const { return passed_veto; }
+        template <class Event>
+        void FillDecision(Event *indelphes, DecisionRecord &record) const;
+        // Bit of the cut flow histogram name, -1 if unknown
+        int StepBit(const TString &name, int &channel) const;
+        // Derived quantities of the last processed event (fcc-higgs-friend.h)
+        template <class Event>
+        void FillDerived(Event *indelphes, DerivedQuantities &derived) const;
+        double MassCollinear(int channel) const { return channel == DECISION_MUTAUE ? mass_collinear_mutaue : mass_collinear_etaumu; }
+        // Also fill N Poisson bootstrap replicas of every histogram
+        void EnableBootstrap(int replicas);
+        // Counts an event read but not processed (failing require= of the
+        // engine) in sum_weights, as the dataset it comes from holds it
+        void SkipEvent(double weight) { sum_weights->Fill(0.5, weight); }
+        // Adds the summed weight of events never read (zones ruled out, or
+        // dropped by a skim) to sum_weights; its entries and sum of squares
+        // only count the events read
+        void AddSkippedWeight(double weight) { sum_weights->AddBinContent(1, weight); }
+
+        PlotSet plots_mutaue;
+        PlotSet plots_etaumu;
+        // Weight (Event.Weight) of every processed event, also those failing
+        // the veto: Sum of weights, Sum of squares and count for the normalisation.
+        // Events of the input not processed are added with SkipEvent and
+        // AddSkippedWeight, so a skim or a require= run normalises like a
+        // run over the whole input
+        TH1D *sum_weights;
+        // Every fill of a highmass or lowmass histogram (fcc-higgs-unbinned.h)
+        vector<SelectedEvent> selected_events;
+        const Region region;
 
     private:
-        double *primed_variable;
-};
-
-void add_hist_shorthand(PlotSet *plots, TString histname, TString propername, vector<int> *histvector)
-{
-    int num = plots->AddHist(new TH1D(histname, propername, HIST_BINS, HIST_START, HIST_END));
-    histvector->push_back(num);
-}
+        // Jet bin of an event with n jets, -1 if outside the region
+        int JetBin(int n) const
+        {
+            int bin = n - region.min_jets;
+            if (region.open_ended and bin >= region.n_jet_bins) bin = region.n_jet_bins - 1;
+            return bin >= 0 and bin < region.n_jet_bins ? bin : -1;
+        }
 
-void read_fcc_higgs_v3(TString infilename, TString outfilename)
-{
+        vector<int> histogram_numbers_mutaue_inclusive;
+        vector<int> histogram_numbers_etaumu_inclusive;
+        vector<vector<int>> histogram_numbers_mutaue;
+        vector<vector<int>> histogram_numbers_etaumu;
 
-    gErrorIgnoreLevel = kFatal;
+        bool plotthis_mutaue_inclusive[3];
+        bool plotthis_etaumu_inclusive[3];
+        vector<vector<bool>> plotthis_mutaue;
+        vector<vector<bool>> plotthis_etaumu;
 
-    TChain *intree = new TChain("Delphes");
-    for (const auto &filename : glob(infilename.Data()))
-    {
-        printf("Reading %s\n", filename.c_str());
-        //TFile *infile = new TFile(filename.c_str());
-        intree->Add(filename.c_str());
-    }
-
-    
-    Delphes *indelphes = new Delphes(intree);
-    intree->SetBranchStatus("*", 0);
-    intree->SetBranchStatus("Jet*", 1);
-    intree->SetBranchStatus("Electron*", 1);
-    intree->SetBranchStatus("Muon*", 1);
-    intree->SetBranchStatus("MissingET*", 1);
+        double mass_collinear_mutaue = 0;
+        double mass_collinear_etaumu = 0;
+        double event_weight = 1;
 
-    PlotSet plots_mutaue;
-    PlotSet plots_etaumu;
+        bool passed_veto = false;
+        int n_passed_jets = 0;
+        int n_passed_b_jets = 0;
+        int chosen_mu[DECISION_NCHANNELS];
+        int chosen_ele[DECISION_NCHANNELS];
+        double x_vis_tau_channel[DECISION_NCHANNELS];
+        double pT_nu_est_channel[DECISION_NCHANNELS];
 
-    vector<int> histogram_numbers_mutaue_inclusive;
-    vector<int> histogram_numbers_etaumu_inclusive;
+        BootstrapWeights *bootstrap = nullptr;
+};
 
-    vector<vector<int>> histogram_numbers_mutaue;
-    vector<vector<int>> histogram_numbers_etaumu;
-    for (int jet = 0; jet <= MAX_JETS; jet++) 
+SelectionV3::SelectionV3(const Region &region) : region(region)
+{
+    for (int jet = 0; jet < region.n_jet_bins; jet++)
     {
         vector<int> vjet;
         histogram_numbers_mutaue.push_back(vjet);
@@ -180,39 +207,35 @@ void read_fcc_higgs_v3(TString infilename, TString outfilename)
     add_hist_shorthand(&plots_etaumu, "etau_mu_step01", "etau_mu no b-jets", &histogram_numbers_etaumu_inclusive);
     add_hist_shorthand(&plots_etaumu, "etau_mu_step02", "etau_mu 0, 1 jet", &histogram_numbers_etaumu_inclusive);
 
-    for (int jet=0; jet<=MAX_JETS; jet++)
+    for (int jet=0; jet<region.n_jet_bins; jet++)
     {
+        int n = region.min_jets + jet;
         vector<int> *mutaue_this = &(histogram_numbers_mutaue[jet]);
         vector<int> *etaumu_this = &(histogram_numbers_etaumu[jet]);
-        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step03_%dj", jet), Form("mutau_e %d jet", jet), mutaue_this);
-        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step04_%dj", jet), Form("mutau_e 1+ muon %d jet", jet), mutaue_this);
-        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step05_%dj", jet), Form("mutau_e 1 muon %d jet", jet), mutaue_this);
-        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step06_%dj", jet), Form("mutau_e 1+ electron %d jet", jet), mutaue_this);
-        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step07_%dj", jet), Form("mutau_e 1 electron %d jet", jet), mutaue_this);
-        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step08_%dj", jet), Form("mutau_e min pT %d jet", jet), mutaue_this);
-        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step09_%dj", jet), Form("mutau_e max deltaPhi e, met %d jet", jet), mutaue_this);
-        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step10_%dj", jet), Form("mutau_e min deltaPhi e, mu %d jet", jet), mutaue_this);
-        add_hist_shorthand(&plots_mutaue, Form("mutau_e_highmass_%dj", jet), Form("mutau_e high mass %d jet", jet), mutaue_this);
-        add_hist_shorthand(&plots_mutaue, Form("mutau_e_lowmass_%dj", jet), Form("mutau_e low mass %d jet", jet), mutaue_this);
-
-        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step03_%dj", jet), Form("etau_mu %d jet", jet), etaumu_this);
-        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step04_%dj", jet), Form("etau_mu 1+ muon %d jet", jet), etaumu_this);
-        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step05_%dj", jet), Form("etau_mu 1 muon %d jet", jet), etaumu_this);
-        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step06_%dj", jet), Form("etau_mu 1+ electron %d jet", jet), etaumu_this);
-        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step07_%dj", jet), Form("etau_mu 1 electron %d jet", jet), etaumu_this);
-        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step08_%dj", jet), Form("etau_mu min pT %d jet", jet), etaumu_this);
-        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step09_%dj", jet), Form("etau_mu max deltaPhi e, met %d jet", jet), etaumu_this);
-        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step10_%dj", jet), Form("etau_mu min deltaPhi e, mu %d jet", jet), etaumu_this);
-        add_hist_shorthand(&plots_etaumu, Form("etau_mu_highmass_%dj", jet), Form("etau_mu high mass %d jet", jet), etaumu_this);
-        add_hist_shorthand(&plots_etaumu, Form("etau_mu_lowmass_%dj", jet), Form("etau_mu low mass %d jet", jet), etaumu_this);
+        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step03_%dj", n), Form("mutau_e %d jet", n), mutaue_this);
+        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step04_%dj", n), Form("mutau_e 1+ muon %d jet", n), mutaue_this);
+        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step05_%dj", n), Form("mutau_e 1 muon %d jet", n), mutaue_this);
+        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step06_%dj", n), Form("mutau_e 1+ electron %d jet", n), mutaue_this);
+        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step07_%dj", n), Form("mutau_e 1 electron %d jet", n), mutaue_this);
+        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step08_%dj", n), Form("mutau_e min pT %d jet", n), mutaue_this);
+        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step09_%dj", n), Form("mutau_e max deltaPhi e, met %d jet", n), mutaue_this);
+        add_hist_shorthand(&plots_mutaue, Form("mutau_e_step10_%dj", n), Form("mutau_e min deltaPhi e, mu %d jet", n), mutaue_this);
+        add_hist_shorthand(&plots_mutaue, Form("mutau_e_highmass_%dj", n), Form("mutau_e high mass %d jet", n), mutaue_this);
+        add_hist_shorthand(&plots_mutaue, Form("mutau_e_lowmass_%dj", n), Form("mutau_e low mass %d jet", n), mutaue_this);
+
+        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step03_%dj", n), Form("etau_mu %d jet", n), etaumu_this);
+        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step04_%dj", n), Form("etau_mu 1+ muon %d jet", n), etaumu_this);
+        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step05_%dj", n), Form("etau_mu 1 muon %d jet", n), etaumu_this);
+        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step06_%dj", n), Form("etau_mu 1+ electron %d jet", n), etaumu_this);
+        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step07_%dj", n), Form("etau_mu 1 electron %d jet", n), etaumu_this);
+        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step08_%dj", n), Form("etau_mu min pT %d jet", n), etaumu_this);
+        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step09_%dj", n), Form("etau_mu max deltaPhi e, met %d jet", n), etaumu_this);
+        add_hist_shorthand(&plots_etaumu, Form("etau_mu_step10_%dj", n), Form("etau_mu min deltaPhi e, mu %d jet", n), etaumu_this);
+        add_hist_shorthand(&plots_etaumu, Form("etau_mu_highmass_%dj", n), Form("etau_mu high mass %d jet", n), etaumu_this);
+        add_hist_shorthand(&plots_etaumu, Form("etau_mu_lowmass_%dj", n), Form("etau_mu low mass %d jet", n), etaumu_this);
     }
 
-    bool plotthis_mutaue_inclusive[3];
-    bool plotthis_etaumu_inclusive[3];
-    
-    vector<vector<bool>> plotthis_mutaue;
-    vector<vector<bool>> plotthis_etaumu;
-    for (int jet=0; jet<=MAX_JETS; jet++)
+    for (int jet=0; jet<region.n_jet_bins; jet++)
     {
         vector<bool> p1, p2;
         for (int s=0; s<10; s++) 
@@ -224,513 +247,553 @@ void read_fcc_higgs_v3(TString infilename, TString outfilename)
         plotthis_etaumu.push_back(p2);
     }
 
-    double mass_collinear_mutaue = 0;
-    double mass_collinear_etaumu = 0;
     plots_mutaue.PrimeFill(&mass_collinear_mutaue);
     plots_etaumu.PrimeFill(&mass_collinear_etaumu);
+    plots_mutaue.PrimeWeight(&event_weight);
+    plots_etaumu.PrimeWeight(&event_weight);
+
+    sum_weights = new TH1D("sum_weights", "event weights of all processed events", 1, 0, 1);
+    sum_weights->Sumw2();
+}
+
+void SelectionV3::EnableBootstrap(int replicas)
+{
+    delete bootstrap;
+    bootstrap = new BootstrapWeights(replicas);
+    plots_mutaue.EnableBootstrap(bootstrap);
+    plots_etaumu.EnableBootstrap(bootstrap);
+}
+
+void SelectionV3::Reset()
+{
+    plots_mutaue.ResetAll();
+    plots_etaumu.ResetAll();
+    sum_weights->Reset();
+    selected_events.clear();
+}
+
+void SelectionV3::Add(const SelectionV3 &other)
+{
+    plots_mutaue.AddAll(other.plots_mutaue);
+    plots_etaumu.AddAll(other.plots_etaumu);
+    sum_weights->Add(other.sum_weights);
+    selected_events.insert(selected_events.end(), other.selected_events.begin(), other.selected_events.end());
+}
+
+void SelectionV3::Scale(double factor)
+{
+    plots_mutaue.ScaleAll(factor);
+    plots_etaumu.ScaleAll(factor);
+    for (auto &event : selected_events) event.weight *= factor;
+}
+
+void SelectionV3::SaveAll(TDirectory *outfile)
+{
+    plots_mutaue.SaveAll(outfile);
+    plots_etaumu.SaveAll(outfile);
+    sum_weights->Write();
+    write_selected_events(outfile, selected_events);
+}
+
+void SelectionV3::LoadAll(TDirectory *infile)
+{
+    plots_mutaue.LoadAll(infile);
+    plots_etaumu.LoadAll(infile);
+    TH1 *stored = nullptr;
+    infile->GetObject(sum_weights->GetName(), stored);
+    if (stored) sum_weights->Add(stored);
+    read_selected_events(infile, selected_events);
+}
+
+template <class Event>
+void SelectionV3::Process(Event *indelphes, ULong64_t source)
+{
+    EventObjects objects;
+    Process(indelphes, objects, source);
+}
 
+template <class Event>
+void SelectionV3::Process(Event *indelphes, EventObjects &objects, ULong64_t source)
+{
     bool full_calculate;
     TLorentzVector p4_tau, p4_lepton;
-    TLorentzVector p4_muon, p4_electron, p4_met;
     double pT_nu_est, x_vis_tau;
     double deltaPhi_e_met, deltaPhi_mu_met, deltaPhi_e_mu;
 
-    for (Long64_t ievent=0; ievent < intree->GetEntries(); ievent++)
+    event_weight = indelphes->Event_Weight[0];
+    sum_weights->Fill(0.5, event_weight);
+    passed_veto = pass_lepton_veto(indelphes);
+    if (!passed_veto) return;
+    objects.Fill(indelphes);
+    if (bootstrap != nullptr) bootstrap->Generate(source, indelphes->Event_Number[0]);
+
+    ///////////////////////////////////////
+    // mu + tau_e
+    ///////////////////////////////////////
+
+    plotthis_mutaue_inclusive[0] = true;
+    plotthis_mutaue_inclusive[1] = false;
+    plotthis_mutaue_inclusive[2] = false;
+    for (int j=0; j<region.n_jet_bins; j++)
     {
-        if (ievent % 10000 == 0) printf("Reading event %lld\n", ievent);
-        indelphes->GetEntry(ievent);
-
-        // Loop to filter lepton
-        // muon > 10 GeV, electron > 5 GeV
-        // any event with additional lepton (after filter) is discarded
-        // only exactly one muon and one electron is allowed
-        // logic: loop through muons and electrons, count number of candidates with pT > threshold
-        // if more than one candidate is found, skip the event
-        int muon_count = 0;
-        for (int mu=0; mu<indelphes->Muon_size; mu++)
-        {
-            if (indelphes->Muon_PT[mu] < 10) continue;
-            if (TMath::Abs(indelphes->Muon_Eta[mu]) > 6.0) continue;
-            muon_count++;
-        }
-        if (muon_count != 1) continue;
-        int electron_count = 0;
-        for (int el=0; el<indelphes->Electron_size; el++)
-        {
-            if (indelphes->Electron_PT[el] < 5) continue;
-            if (TMath::Abs(indelphes->Electron_Eta[el]) > 6.0) continue;
-            electron_count++;
-        }
-        if (electron_count != 1) continue;
-        ///////////////////////////////////////
-        // mu + tau_e
-        ///////////////////////////////////////
-
-        plotthis_mutaue_inclusive[0] = true;
-        plotthis_mutaue_inclusive[1] = false;
-        plotthis_mutaue_inclusive[2] = false;
-        for (int j=0; j<=MAX_JETS; j++)
-        {
-            for (int s=0; s<10; s++) plotthis_mutaue[j][s] = false;
-        }
+        for (int s=0; s<10; s++) plotthis_mutaue[j][s] = false;
+    }
 
-        vector<int> passed_jets;
-        vector<int> passed_b_jets;
-        vector<int> muon_vec;
-        vector<int> electron_vec;
-        int only_mu  = -1;
-        int only_ele = -1;
+    const vector<int> &passed_jets = objects.jets;
+    const vector<int> &passed_b_jets = objects.b_jets;
+    vector<int> muon_vec;
+    vector<int> electron_vec;
+    int only_mu  = -1;
+    int only_ele = -1;
 
-        for (int j=0; j<indelphes->Jet_size; j++)
-        {
-            if (indelphes->Jet_PT[j] < 30) continue;
-            if (TMath::Abs(indelphes->Jet_Eta[j]) > 6.0) continue;
-            passed_jets.push_back(j);
-            if (indelphes->Jet_BTag[j] & 0b111) passed_b_jets.push_back(j);
-        }
-        //if (passed_b_jets.size() == 0) plotthis_mutaue[0] = true;
-        //plotthis_mutaue[0] = passed_b_jets.size() == 0;
-        //plotthis_mutaue[1] = plotthis_mutaue[0] and passed_jets.size() <= 1;
+    n_passed_jets = passed_jets.size();
+    n_passed_b_jets = passed_b_jets.size();
 
-        plotthis_mutaue_inclusive[1] = passed_b_jets.size() == 0;
-        plotthis_mutaue_inclusive[2] = plotthis_mutaue_inclusive[1] and passed_jets.size() <= MAX_JETS;
+    plotthis_mutaue_inclusive[1] = region.require_bjet ? passed_b_jets.size() > 0 : passed_b_jets.size() == 0;
+    plotthis_mutaue_inclusive[2] = plotthis_mutaue_inclusive[1] and JetBin(passed_jets.size()) >= 0;
 
-        /*
-        if (plotthis_mutaue[1])
-        {
-            plotthis_mutaue[2] = passed_jets.size() == 0;
-            plotthis_mutaue[3] = passed_jets.size() == 1;
-            plotthis_mutaue[4] = plotthis_mutaue[2];
-            plotthis_mutaue[5] = plotthis_mutaue[3];
-        }
-        if (plotthis_mutaue[2] or plotthis_mutaue[3])
+    for (int njet=0; njet<region.n_jet_bins; njet++)
+    {
+        if (!plotthis_mutaue_inclusive[2]) continue;
+        plotthis_mutaue[njet][0] = JetBin(passed_jets.size()) == njet;
+        if (plotthis_mutaue[njet][0])
         {
             muon_vec = find_mu(indelphes, 53, -1);
-            if (muon_vec.size() == 0)
-            {
-                plotthis_mutaue[4] = false;
-                plotthis_mutaue[5] = false;
-            }
-            plotthis_mutaue[6] = plotthis_mutaue[4];
-            plotthis_mutaue[7] = plotthis_mutaue[5];
-            if (muon_vec.size() > 1)
-            {
-                plotthis_mutaue[6] = false;
-                plotthis_mutaue[7] = false;
-            }
-            plotthis_mutaue[8] = plotthis_mutaue[6];
-            plotthis_mutaue[9] = plotthis_mutaue[7];
+            plotthis_mutaue[njet][1] = muon_vec.size() > 0;
+            plotthis_mutaue[njet][2] = muon_vec.size() == 1;
         }
-        if (plotthis_mutaue[6] or plotthis_mutaue[7])
+        if (plotthis_mutaue[njet][2])
         {
-            electron_vec = find_ele(indelphes, 10, plotthis_mutaue[6] or plotthis_mutaue[7] ? muon_vec[0] : -1);
-            if (electron_vec.size() == 0)
-            {
-                plotthis_mutaue[8] = false;
-                plotthis_mutaue[9] = false;
-            }
-            plotthis_mutaue[10] = plotthis_mutaue[8];
-            plotthis_mutaue[11] = plotthis_mutaue[9];
-            if (electron_vec.size() > 1)
-            {
-                plotthis_mutaue[10] = false;
-                plotthis_mutaue[11] = false;
-            }
-            plotthis_mutaue[12] = plotthis_mutaue[10];
-            plotthis_mutaue[13] = plotthis_mutaue[11];
+            electron_vec = find_ele(indelphes, 10, plotthis_mutaue[njet][2] ? muon_vec[0] : -1, region.same_sign);
+            plotthis_mutaue[njet][3] = electron_vec.size() > 0;
+            plotthis_mutaue[njet][4] = electron_vec.size() == 1;
         }
-        if (plotthis_mutaue[10] or plotthis_mutaue[11])
+        if (plotthis_mutaue[njet][4])
         {
             only_mu = muon_vec[0];
             only_ele = electron_vec[0];
-            if (indelphes->Muon_PT[only_mu] < 60)
-            {
-                plotthis_mutaue[12] = false;
-                plotthis_mutaue[13] = false;
-            }
-            plotthis_mutaue[14] = plotthis_mutaue[12];
-            plotthis_mutaue[15] = plotthis_mutaue[13];
+            plotthis_mutaue[njet][5] = indelphes->Muon_PT[only_mu] > 60;
         }
-        if (plotthis_mutaue[12] or plotthis_mutaue[13])
+        if (plotthis_mutaue[njet][5])
         {
             deltaPhi_e_met = deltaPhi(indelphes->Electron_Phi[only_ele], indelphes->MissingET_Phi[0]);
-            if (deltaPhi_e_met > 0.7)
-            {
-                plotthis_mutaue[14] = false;
-                plotthis_mutaue[15] = false;
-            }
-            plotthis_mutaue[16] = plotthis_mutaue[14];
-            plotthis_mutaue[17] = plotthis_mutaue[15];
+            plotthis_mutaue[njet][6] = deltaPhi_e_met < 0.7;
         }
-        if (plotthis_mutaue[14] or plotthis_mutaue[15])
+        if (plotthis_mutaue[njet][6])
         {
             deltaPhi_e_mu = deltaPhi(indelphes->Electron_Phi[only_ele], indelphes->Muon_Phi[only_mu]);
-            if (deltaPhi_e_mu < 2.2)
-            {
-                plotthis_mutaue[16] = false;
-                plotthis_mutaue[17] = false;
-            }
+            plotthis_mutaue[njet][7] = deltaPhi_e_mu > 2.2;
         }
-        if (plotthis_mutaue[16]) // zero jets
+        if (plotthis_mutaue[njet][7])
         {
-            plotthis_mutaue[18] = indelphes->Muon_PT[only_mu] > 150 and deltaPhi_e_met < 0.3;
-            plotthis_mutaue[20] = indelphes->Muon_PT[only_mu] > 60  and deltaPhi_e_met < 0.7;
+            plotthis_mutaue[njet][8] = indelphes->Muon_PT[only_mu] > 150 and deltaPhi_e_met < 0.3;
+            plotthis_mutaue[njet][9] = indelphes->Muon_PT[only_mu] > 60 and deltaPhi_e_met < 0.7;
         }
-        if (plotthis_mutaue[17]) // one jet
-        {
-            plotthis_mutaue[19] = indelphes->Muon_PT[only_mu] > 150 and deltaPhi_e_met < 0.3;
-            plotthis_mutaue[21] = indelphes->Muon_PT[only_mu] > 60  and deltaPhi_e_met < 0.7;
-        }
-
-        //TLorentzVector p4_tau;
-        //TLorentzVector p4_lepton;
-        if (plotthis_mutaue[16] or plotthis_mutaue[17])
-        {
-            p4_tau.SetPtEtaPhiM(indelphes->Electron_PT[only_ele], indelphes->Electron_Eta[only_ele], indelphes->Electron_Phi[only_ele], 0.000511);
-            p4_lepton.SetPtEtaPhiM(indelphes->Muon_PT[only_mu], indelphes->Muon_Eta[only_mu], indelphes->Muon_Phi[only_mu], 0.10566);
-        }
-        else
-        {
-            //TLorentzVector p4_muon, p4_electron, p4_met;
-            if (indelphes->Muon_size > 0) p4_muon.SetPtEtaPhiM(indelphes->Muon_PT[0], indelphes->Muon_Eta[0], indelphes->Muon_Phi[0], 0.10566);
-            else p4_muon.SetPtEtaPhiM(0, 0, 0, 0.10566);
-            if (indelphes->Electron_size > 0) p4_electron.SetPtEtaPhiM(indelphes->Electron_PT[0], indelphes->Electron_Eta[0], indelphes->Electron_Phi[0], 0.000511);
-            else p4_electron.SetPtEtaPhiM(0, 0, 0, 0.000511);
-            p4_met.SetPtEtaPhiM(indelphes->MissingET_MET[0], 0, indelphes->MissingET_Phi[0], 0);
-            if (p4_muon.DeltaR(p4_met) < p4_electron.DeltaR(p4_met))
-            {
-                p4_tau.SetPtEtaPhiM(p4_muon.Pt(), p4_muon.Eta(), p4_muon.Phi(), 0.10566);
-                p4_lepton.SetPtEtaPhiM(p4_electron.Pt(), p4_electron.Eta(), p4_electron.Phi(), 0.000511);
-            }
-            else
-            {
-                p4_lepton.SetPtEtaPhiM(p4_muon.Pt(), p4_muon.Eta(), p4_muon.Phi(), 0.10566);
-                p4_tau.SetPtEtaPhiM(p4_electron.Pt(), p4_electron.Eta(), p4_electron.Phi(), 0.000511);
-            }
-        }
-        pT_nu_est = indelphes->MissingET_MET[0] * TMath::Cos(deltaPhi(indelphes->MissingET_Phi[0], p4_tau.Phi()));
-        x_vis_tau = p4_tau.Pt() / (p4_tau.Pt() + pT_nu_est);
-        mass_collinear_mutaue = (p4_tau+p4_lepton).M() / TMath::Sqrt(x_vis_tau);
+    }
 
-        for (int i=0; i<23; i++) if (plotthis_mutaue[i]) plots_mutaue.Fill(i);
-        */
+    full_calculate = false;
+    for (int njet=0; njet<region.n_jet_bins; njet++) full_calculate = full_calculate or plotthis_mutaue[njet][7];
 
-        for (int njet=0; njet<=MAX_JETS; njet++)
-        {
-            if (!plotthis_mutaue_inclusive[2]) continue;
-            plotthis_mutaue[njet][0] = passed_jets.size() == njet;
-            if (plotthis_mutaue[njet][0])
-            {
-                muon_vec = find_mu(indelphes, 53, -1);
-                plotthis_mutaue[njet][1] = muon_vec.size() > 0;
-                plotthis_mutaue[njet][2] = muon_vec.size() == 1;
-            }
-            if (plotthis_mutaue[njet][2])
-            {
-                electron_vec = find_ele(indelphes, 10, plotthis_mutaue[njet][2] ? muon_vec[0] : -1);
-                plotthis_mutaue[njet][3] = electron_vec.size() > 0;
-                plotthis_mutaue[njet][4] = electron_vec.size() == 1;
-            }
-            if (plotthis_mutaue[njet][4])
-            {
-                only_mu = muon_vec[0];
-                only_ele = electron_vec[0];
-                plotthis_mutaue[njet][5] = indelphes->Muon_PT[only_mu] > 60;
-            }
-            if (plotthis_mutaue[njet][5])
-            {
-                deltaPhi_e_met = deltaPhi(indelphes->Electron_Phi[only_ele], indelphes->MissingET_Phi[0]);
-                plotthis_mutaue[njet][6] = deltaPhi_e_met < 0.7;
-            }
-            if (plotthis_mutaue[njet][6])
-            {
-                deltaPhi_e_mu = deltaPhi(indelphes->Electron_Phi[only_ele], indelphes->Muon_Phi[only_mu]);
-                plotthis_mutaue[njet][7] = deltaPhi_e_mu > 2.2;
-            }
-            if (plotthis_mutaue[njet][7])
-            {
-                plotthis_mutaue[njet][8] = indelphes->Muon_PT[only_mu] > 150 and deltaPhi_e_met < 0.3;
-                plotthis_mutaue[njet][9] = indelphes->Muon_PT[only_mu] > 60 and deltaPhi_e_met < 0.7;
-            }
-        }
-
-        full_calculate = false;
-        for (int njet=0; njet<=MAX_JETS; njet++) full_calculate = full_calculate or plotthis_mutaue[njet][7];
+    if (full_calculate)
+    {
+        p4_tau.SetPtEtaPhiM(indelphes->Electron_PT[only_ele], indelphes->Electron_Eta[only_ele], indelphes->Electron_Phi[only_ele], 0.000511);
+        p4_lepton.SetPtEtaPhiM(indelphes->Muon_PT[only_mu], indelphes->Muon_Eta[only_mu], indelphes->Muon_Phi[only_mu], 0.10566);
+    }
+    else
+    {
+        p4_tau = objects.fallback_tau;
+        p4_lepton = objects.fallback_lepton;
+    }
 
-        if (full_calculate)
-        {
-            p4_tau.SetPtEtaPhiM(indelphes->Electron_PT[only_ele], indelphes->Electron_Eta[only_ele], indelphes->Electron_Phi[only_ele], 0.000511);
-            p4_lepton.SetPtEtaPhiM(indelphes->Muon_PT[only_mu], indelphes->Muon_Eta[only_mu], indelphes->Muon_Phi[only_mu], 0.10566);
-        }
-        else
-        {
-            if (indelphes->Muon_size > 0) p4_muon.SetPtEtaPhiM(indelphes->Muon_PT[0], indelphes->Muon_Eta[0], indelphes->Muon_Phi[0], 0.10566);
-            else p4_muon.SetPtEtaPhiM(0, 0, 0, 0.10566);
-            if (indelphes->Electron_size > 0) p4_electron.SetPtEtaPhiM(indelphes->Electron_PT[0], indelphes->Electron_Eta[0], indelphes->Electron_Phi[0], 0.000511);
-            else p4_electron.SetPtEtaPhiM(0, 0, 0, 0.000511);
-            p4_met.SetPtEtaPhiM(indelphes->MissingET_MET[0], 0, indelphes->MissingET_Phi[0], 0);
-            if (p4_muon.DeltaR(p4_met) < p4_electron.DeltaR(p4_met))
-            {
-                p4_tau.SetPtEtaPhiM(p4_muon.Pt(), p4_muon.Eta(), p4_muon.Phi(), 0.10566);
-                p4_lepton.SetPtEtaPhiM(p4_electron.Pt(), p4_electron.Eta(), p4_electron.Phi(), 0.000511);
-            }
-            else
-            {
-                p4_lepton.SetPtEtaPhiM(p4_muon.Pt(), p4_muon.Eta(), p4_muon.Phi(), 0.10566);
-                p4_tau.SetPtEtaPhiM(p4_electron.Pt(), p4_electron.Eta(), p4_electron.Phi(), 0.000511);
-            }
-        }
+    pT_nu_est = indelphes->MissingET_MET[0] * TMath::Cos(deltaPhi(indelphes->MissingET_Phi[0], p4_tau.Phi()));
+    x_vis_tau = p4_tau.Pt() / (p4_tau.Pt() + pT_nu_est);
+    mass_collinear_mutaue = (p4_tau+p4_lepton).M() / TMath::Sqrt(x_vis_tau);
+    chosen_mu[DECISION_MUTAUE] = only_mu;
+    chosen_ele[DECISION_MUTAUE] = only_ele;
+    x_vis_tau_channel[DECISION_MUTAUE] = x_vis_tau;
+    pT_nu_est_channel[DECISION_MUTAUE] = pT_nu_est;
 
-        pT_nu_est = indelphes->MissingET_MET[0] * TMath::Cos(deltaPhi(indelphes->MissingET_Phi[0], p4_tau.Phi()));
-        x_vis_tau = p4_tau.Pt() / (p4_tau.Pt() + pT_nu_est);
-        mass_collinear_mutaue = (p4_tau+p4_lepton).M() / TMath::Sqrt(x_vis_tau);
+    for (int i=0; i<3; i++) if (plotthis_mutaue_inclusive[i]) plots_mutaue.Fill(histogram_numbers_mutaue_inclusive[i]);
+    for (int j=0; j<region.n_jet_bins; j++)
+    {
+        for (int i=0; i<10; i++) if (plotthis_mutaue[j][i]) plots_mutaue.Fill(histogram_numbers_mutaue[j][i]);
+        if (plotthis_mutaue[j][8]) selected_events.push_back({DECISION_MUTAUE, 1, (UChar_t) (region.min_jets + j), (Float_t) mass_collinear_mutaue, (Float_t) event_weight});
+        if (plotthis_mutaue[j][9]) selected_events.push_back({DECISION_MUTAUE, 0, (UChar_t) (region.min_jets + j), (Float_t) mass_collinear_mutaue, (Float_t) event_weight});
+    }
 
-        for (int i=0; i<3; i++) if (plotthis_mutaue_inclusive[i]) plots_mutaue.Fill(histogram_numbers_mutaue_inclusive[i]);
-        for (int j=0; j<=MAX_JETS; j++)
-        {
-            for (int i=0; i<10; i++) if (plotthis_mutaue[j][i]) plots_mutaue.Fill(histogram_numbers_mutaue[j][i]);
-        }
+    ///////////////////////////////////////
+    // e + tau_mu
+    ///////////////////////////////////////
 
-        ///////////////////////////////////////
-        // e + tau_mu
-        ///////////////////////////////////////
+    plotthis_etaumu_inclusive[0] = true;
+    plotthis_etaumu_inclusive[1] = false;
+    plotthis_etaumu_inclusive[2] = false;
+    for (int j=0; j<region.n_jet_bins; j++)
+    {
+        for (int s=0; s<10; s++) plotthis_etaumu[j][s] = false;
+    }
 
-        plotthis_etaumu_inclusive[0] = true;
-        plotthis_etaumu_inclusive[1] = false;
-        plotthis_etaumu_inclusive[2] = false;
-        for (int j=0; j<=MAX_JETS; j++)
-        {
-            for (int s=0; s<10; s++) plotthis_etaumu[j][s] = false;
-        }
+    muon_vec.clear();
+    electron_vec.clear();
+    only_mu  = -1;
+    only_ele = -1;
 
-        passed_jets.clear();
-        passed_b_jets.clear();
-        muon_vec.clear();
-        electron_vec.clear();
-        only_mu  = -1;
-        only_ele = -1;
+    plotthis_etaumu_inclusive[1] = region.require_bjet ? passed_b_jets.size() > 0 : passed_b_jets.size() == 0;
+    plotthis_etaumu_inclusive[2] = plotthis_etaumu_inclusive[1] and JetBin(passed_jets.size()) >= 0;
 
-        /*
-        for (int j=0; j<indelphes->Jet_size; j++)
-        {
-            if (indelphes->Jet_PT[j] < 30) continue;
-            if (TMath::Abs(indelphes->Jet_Eta[j]) > 6.0) continue;
-            passed_jets.push_back(j);
-            if (indelphes->Jet_BTag[j] & 0b111) passed_b_jets.push_back(j);
-        }
-        //if (passed_b_jets.size() == 0) plotthis_etaumu[0] = true;
-        plotthis_etaumu[0] = passed_b_jets.size() == 0;
-        plotthis_etaumu[1] = plotthis_etaumu[0] and passed_jets.size() <= 1;
-        if (plotthis_etaumu[1])
-        {
-            plotthis_etaumu[2] = passed_jets.size() == 0;
-            plotthis_etaumu[3] = passed_jets.size() == 1;
-            plotthis_etaumu[4] = plotthis_etaumu[2];
-            plotthis_etaumu[5] = plotthis_etaumu[3];
-        }
-        if (plotthis_etaumu[2] or plotthis_etaumu[3])
+    for (int njet=0; njet<region.n_jet_bins; njet++)
+    {
+        if (!plotthis_etaumu_inclusive[2]) continue;
+        plotthis_etaumu[njet][0] = JetBin(passed_jets.size()) == njet;
+        if (plotthis_etaumu[njet][0])
         {
             electron_vec = find_ele(indelphes, 26, -1);
-            if (electron_vec.size() == 0)
-            {
-                plotthis_etaumu[4] = false;
-                plotthis_etaumu[5] = false;
-            }
-            plotthis_etaumu[6] = plotthis_etaumu[4];
-            plotthis_etaumu[7] = plotthis_etaumu[5];
-            if (electron_vec.size() > 1)
-            {
-                plotthis_etaumu[6] = false;
-                plotthis_etaumu[7] = false;
-            }
-            plotthis_etaumu[8] = plotthis_etaumu[6];
-            plotthis_etaumu[9] = plotthis_etaumu[7];
+            plotthis_etaumu[njet][1] = electron_vec.size() > 0;
+            plotthis_etaumu[njet][2] = electron_vec.size() == 1;
         }
-        if (plotthis_etaumu[6] or plotthis_etaumu[7])
+        if (plotthis_etaumu[njet][2])
         {
-            muon_vec = find_mu(indelphes, 10, plotthis_etaumu[6] or plotthis_etaumu[7] ? electron_vec[0] : -1);
-            if (muon_vec.size() == 0)
+            muon_vec = find_mu(indelphes, 10, plotthis_etaumu[njet][6] ? electron_vec[0] : -1);
+            // The signal region checks neither the charge nor the deltaR of
+            // the pair here, so the same-sign region only adds the charge and
+            // keeps the muon search as it is. Unlike in mutau_e, its events
+            // are then also in the signal region.
+            if (region.same_sign)
             {
-                plotthis_etaumu[8] = false;
-                plotthis_etaumu[9] = false;
+                int charge = indelphes->Electron_Charge[electron_vec[0]];
+                muon_vec.erase(remove_if(muon_vec.begin(), muon_vec.end(), [&](int mu) { return indelphes->Muon_Charge[mu] != charge; }), muon_vec.end());
             }
-            plotthis_etaumu[10] = plotthis_etaumu[8];
-            plotthis_etaumu[11] = plotthis_etaumu[9];
-            if (muon_vec.size() > 1)
-            {
-                plotthis_etaumu[10] = false;
-                plotthis_etaumu[11] = false;
-            }
-            plotthis_etaumu[12] = plotthis_etaumu[10];
-            plotthis_etaumu[13] = plotthis_etaumu[11];
+            plotthis_etaumu[njet][3] = muon_vec.size() > 0;
+            plotthis_etaumu[njet][4] = muon_vec.size() == 1;
         }
-        if (plotthis_etaumu[10] or plotthis_etaumu[11])
+        if (plotthis_etaumu[njet][4])
         {
             only_mu = muon_vec[0];
             only_ele = electron_vec[0];
-            if (indelphes->Electron_PT[only_ele] < 60)
-            {
-                plotthis_etaumu[12] = false;
-                plotthis_etaumu[13] = false;
-            }
-            plotthis_etaumu[14] = plotthis_etaumu[12];
-            plotthis_etaumu[15] = plotthis_etaumu[13];
+            plotthis_etaumu[njet][5] = indelphes->Electron_PT[only_ele] > 60;
         }
-        if (plotthis_etaumu[12] or plotthis_etaumu[13])
+        if (plotthis_etaumu[njet][5])
         {
             deltaPhi_mu_met = deltaPhi(indelphes->Muon_Phi[only_mu], indelphes->MissingET_Phi[0]);
-            if (deltaPhi_mu_met > 0.7)
-            {
-                plotthis_etaumu[14] = false;
-                plotthis_etaumu[15] = false;
-            }
-            plotthis_etaumu[16] = plotthis_etaumu[14];
-            plotthis_etaumu[17] = plotthis_etaumu[15];
+            plotthis_etaumu[njet][6] = deltaPhi_mu_met < 0.7;
         }
-        if (plotthis_etaumu[14] or plotthis_etaumu[15])
+        if (plotthis_etaumu[njet][6])
         {
             deltaPhi_e_mu = deltaPhi(indelphes->Electron_Phi[only_ele], indelphes->Muon_Phi[only_mu]);
-            if (deltaPhi_e_mu < 2.2)
-            {
-                plotthis_etaumu[16] = false;
-                plotthis_etaumu[17] = false;
-            }
+            plotthis_etaumu[njet][7] = deltaPhi_e_mu > 2.2;
         }
-        if (plotthis_etaumu[16]) // zero jets
+        if (plotthis_etaumu[njet][7])
         {
-            plotthis_etaumu[18] = indelphes->Electron_PT[only_ele] > 150 and deltaPhi_mu_met < 0.3;
-            plotthis_etaumu[20] = indelphes->Electron_PT[only_ele] > 60  and deltaPhi_mu_met < 0.7;
-        }
-        if (plotthis_etaumu[17]) // one jet
-        {
-            plotthis_etaumu[19] = indelphes->Electron_PT[only_ele] > 150 and deltaPhi_mu_met < 0.3;
-            plotthis_etaumu[21] = indelphes->Electron_PT[only_ele] > 60  and deltaPhi_mu_met < 0.7;
+            plotthis_etaumu[njet][8] = indelphes->Electron_PT[only_ele] > 150 and deltaPhi_mu_met < 0.3;
+            plotthis_etaumu[njet][9] = indelphes->Electron_PT[only_ele] > 60 and deltaPhi_mu_met < 0.7;
         }
+    }
+
+    full_calculate = false;
+    for (int njet=0; njet<region.n_jet_bins; njet++) full_calculate = full_calculate or plotthis_etaumu[njet][7];
+
+    if (full_calculate)
+    {
+        p4_lepton.SetPtEtaPhiM(indelphes->Electron_PT[only_ele], indelphes->Electron_Eta[only_ele], indelphes->Electron_Phi[only_ele], 0.000511);
+        p4_tau.SetPtEtaPhiM(indelphes->Muon_PT[only_mu], indelphes->Muon_Eta[only_mu], indelphes->Muon_Phi[only_mu], 0.10566);
+    }
+    else
+    {
+        p4_tau = objects.fallback_tau;
+        p4_lepton = objects.fallback_lepton;
+    }
+
+    pT_nu_est = indelphes->MissingET_MET[0] * TMath::Cos(deltaPhi(indelphes->MissingET_Phi[0], p4_tau.Phi()));
+    x_vis_tau = p4_tau.Pt() / (p4_tau.Pt() + pT_nu_est);
+    mass_collinear_etaumu = (p4_tau+p4_lepton).M() / TMath::Sqrt(x_vis_tau);
+    chosen_mu[DECISION_ETAUMU] = only_mu;
+    chosen_ele[DECISION_ETAUMU] = only_ele;
+    x_vis_tau_channel[DECISION_ETAUMU] = x_vis_tau;
+    pT_nu_est_channel[DECISION_ETAUMU] = pT_nu_est;
+
+    for (int i=0; i<3; i++) if (plotthis_etaumu_inclusive[i]) plots_etaumu.Fill(histogram_numbers_etaumu_inclusive[i]);
+    for (int j=0; j<region.n_jet_bins; j++)
+    {
+        for (int i=0; i<10; i++) if (plotthis_etaumu[j][i]) plots_etaumu.Fill(histogram_numbers_etaumu[j][i]);
+        if (plotthis_etaumu[j][8]) selected_events.push_back({DECISION_ETAUMU, 1, (UChar_t) (region.min_jets + j), (Float_t) mass_collinear_etaumu, (Float_t) event_weight});
+        if (plotthis_etaumu[j][9]) selected_events.push_back({DECISION_ETAUMU, 0, (UChar_t) (region.min_jets + j), (Float_t) mass_collinear_etaumu, (Float_t) event_weight});
+    }
+}
+
+/*
+Every cut of both channels on its own, with the same values as Process,
+for N-1 distributions. As in Process, the muon search of etau_mu does
+not look at the electron.
+*/
+template <class Event>
+void SelectionV3::FillDecision(Event *indelphes, DecisionRecord &record) const
+{
+    record.number = indelphes->Event_Number[0];
+    record.njet = n_passed_jets;
+
+    for (int channel=0; channel<DECISION_NCHANNELS; channel++)
+    {
+        bool mutaue = channel == DECISION_MUTAUE;
+        const vector<vector<bool>> &plotthis = mutaue ? plotthis_mutaue : plotthis_etaumu;
+        const bool *plotthis_inclusive = mutaue ? plotthis_mutaue_inclusive : plotthis_etaumu_inclusive;
+        const vector<int> &numbers_inclusive = mutaue ? histogram_numbers_mutaue_inclusive : histogram_numbers_etaumu_inclusive;
+        const vector<vector<int>> &numbers = mutaue ? histogram_numbers_mutaue : histogram_numbers_etaumu;
+
+        ULong64_t steps = 0;
+        for (int i=0; i<3; i++) if (plotthis_inclusive[i]) steps |= 1ULL << numbers_inclusive[i];
+        for (int j=0; j<region.n_jet_bins; j++)
+        {
+            for (int i=0; i<10; i++) if (plotthis[j][i]) steps |= 1ULL << numbers[j][i];
+        }
+        record.steps[channel] = steps;
+
+        ULong64_t cuts = 0;
+        if (n_passed_b_jets == 0) cuts |= 1ULL << CUT_NO_BJET;
+        if (n_passed_jets <= MAX_JETS) cuts |= 1ULL << CUT_MAX_JETS;
+        vector<int> lead_vec = mutaue ? find_mu(indelphes, 53, -1) : find_ele(indelphes, 26, -1);
+        if (lead_vec.size() > 0) cuts |= 1ULL << CUT_LEAD_FOUND;
+        if (lead_vec.size() == 1) cuts |= 1ULL << CUT_LEAD_ONE;
+        vector<int> tau_vec = mutaue ? find_ele(indelphes, 10, lead_vec.size() == 1 ? lead_vec[0] : -1) : find_mu(indelphes, 10, -1);
+        if (tau_vec.size() > 0) cuts |= 1ULL << CUT_TAU_FOUND;
+        if (tau_vec.size() == 1) cuts |= 1ULL << CUT_TAU_ONE;
+        if (lead_vec.size() == 1 and tau_vec.size() == 1)
+        {
+            int only_mu = mutaue ? lead_vec[0] : tau_vec[0];
+            int only_ele = mutaue ? tau_vec[0] : lead_vec[0];
+            double lead_pt = mutaue ? indelphes->Muon_PT[only_mu] : indelphes->Electron_PT[only_ele];
+            double tau_phi = mutaue ? indelphes->Electron_Phi[only_ele] : indelphes->Muon_Phi[only_mu];
+            double deltaPhi_tau_met = deltaPhi(tau_phi, indelphes->MissingET_Phi[0]);
+            if (lead_pt > 60) cuts |= 1ULL << CUT_LEAD_PT;
+            if (deltaPhi_tau_met < 0.7) cuts |= 1ULL << CUT_DPHI_MET;
+            if (deltaPhi(indelphes->Electron_Phi[only_ele], indelphes->Muon_Phi[only_mu]) > 2.2) cuts |= 1ULL << CUT_DPHI_EMU;
+            if (lead_pt > 150 and deltaPhi_tau_met < 0.3) cuts |= 1ULL << CUT_HIGHMASS;
+        }
+        record.cuts[channel] = cuts;
+    }
+}
+
+template <class Event>
+void SelectionV3::FillDerived(Event *indelphes, DerivedQuantities &derived) const
+{
+    derived.Clear();
+    derived.number = indelphes->Event_Number[0];
+    if (!passed_veto) return;
+    derived.passed_veto = 1;
+    derived.njet = n_passed_jets;
+    derived.nbjet = n_passed_b_jets;
+    for (int channel=0; channel<DECISION_NCHANNELS; channel++)
+    {
+        derived.mu[channel] = chosen_mu[channel];
+        derived.ele[channel] = chosen_ele[channel];
+        derived.mass_collinear[channel] = MassCollinear(channel);
+        derived.x_vis_tau[channel] = x_vis_tau_channel[channel];
+        derived.pt_nu_est[channel] = pT_nu_est_channel[channel];
+        int mu = chosen_mu[channel] >= 0 ? chosen_mu[channel] : (indelphes->Muon_size > 0 ? 0 : -1);
+        int ele = chosen_ele[channel] >= 0 ? chosen_ele[channel] : (indelphes->Electron_size > 0 ? 0 : -1);
+        if (ele >= 0) derived.dphi_e_met[channel] = deltaPhi(indelphes->Electron_Phi[ele], indelphes->MissingET_Phi[0]);
+        if (mu >= 0) derived.dphi_mu_met[channel] = deltaPhi(indelphes->Muon_Phi[mu], indelphes->MissingET_Phi[0]);
+        if (mu >= 0 and ele >= 0) derived.dphi_e_mu[channel] = deltaPhi(indelphes->Electron_Phi[ele], indelphes->Muon_Phi[mu]);
+    }
+}
+
+int SelectionV3::StepBit(const TString &name, int &channel) const
+{
+    for (channel=0; channel<DECISION_NCHANNELS; channel++)
+    {
+        const PlotSet &plots = channel == DECISION_MUTAUE ? plots_mutaue : plots_etaumu;
+        for (size_t i=0; i<plots.histograms.size(); i++) if (name == plots.histograms[i]->GetName()) return i;
+    }
+    return -1;
+}
+
+// Sum of the event weights of the entries [first, last) of a Delphes or
+// flat tree, reading only the weight; 1 per entry without weights
+double tree_sum_weights(TTree *tree, bool flat, Long64_t first, Long64_t last)
+{
+    const char *branch = flat ? "Event_Weight" : "Event.Weight";
+    if (tree->GetBranch(branch) == nullptr) return last - first;
+    Float_t weight[Delphes::kMaxEvent] = {1};
+    tree->SetBranchStatus("*", 0);
+    if (!flat) tree->SetBranchStatus("Event", 1);
+    tree->SetBranchStatus(branch, 1);
+    tree->SetBranchAddress(branch, weight);
+    double sum = 0;
+    for (Long64_t i=first; i<last; i++)
+    {
+        tree->GetEntry(i);
+        sum += weight[0];
+    }
+    tree->ResetBranchAddresses();
+    return sum;
+}
 
-        //TLorentzVector p4_tau;
-        //TLorentzVector p4_lepton;
-        if (plotthis_etaumu[16] or plotthis_etaumu[17])
+// Weight of the events a skim (skim-fcc-higgs.cpp) dropped from its input:
+// skim_input_sum_weights less the weights of the events it kept. 0 for
+// any other file.
+double skim_dropped_weight(const string &filename)
+{
+    TFile *infile = TFile::Open(filename.c_str());
+    if (infile == nullptr or infile->IsZombie())
+    {
+        delete infile;
+        return 0;
+    }
+    double dropped = 0;
+    TParameter<double> *input_sum_weights = nullptr;
+    infile->GetObject("skim_input_sum_weights", input_sum_weights);
+    TTree *tree = nullptr;
+    bool flat = true;
+    infile->GetObject(FLAT_TREE_NAME, tree);
+    if (tree == nullptr)
+    {
+        flat = false;
+        infile->GetObject("Delphes", tree);
+    }
+    if (input_sum_weights != nullptr and tree != nullptr)
+    {
+        dropped = input_sum_weights->GetVal() - tree_sum_weights(tree, flat, 0, tree->GetEntries());
+    }
+    delete input_sum_weights;
+    delete infile;
+    return dropped;
+}
+
+/*
+options (space separated, all optional):
+    checkpoint=N  every N entries, save the histograms and the next entry
+                  to OUTPUT.checkpoint (atomically replaced)
+    resume        continue from OUTPUT.checkpoint if it exists; the final
+                  histograms are the same as from an uninterrupted run
+    friend        also write the derived quantities of every event to
+                  OUTPUT.friend.root (fcc-higgs-friend.h), aligned with the
+                  input entries; not together with resume
+    bootstrap=N   also fill N Poisson bootstrap replicas of every histogram,
+                  saved as NAME_bootstrap (fcc-higgs-bootstrap.h)
+*/
+void read_fcc_higgs_v3(TString infilename, TString outfilename, TString options = "")
+{
+
+    gErrorIgnoreLevel = kFatal;
+
+    Long64_t checkpoint_every = 0;
+    bool resume = false;
+    bool write_friend = false;
+    int bootstrap = 0;
+    istringstream tokens(options.Data());
+    string token;
+    while (tokens >> token)
+    {
+        if (token.rfind("checkpoint=", 0) == 0) checkpoint_every = atoll(token.c_str() + 11);
+        else if (token == "resume") resume = true;
+        else if (token == "friend") write_friend = true;
+        else if (token.rfind("bootstrap=", 0) == 0) bootstrap = atoi(token.c_str() + 10);
+        else printf("Unknown option %s\n", token.c_str());
+    }
+    TString checkpoint_path = outfilename + ".checkpoint";
+
+    // Flat skims (fcc-higgs-flat.h) are read with FlatEvent, anything else
+    // as Delphes files
+    vector<string> filenames = glob(infilename.Data());
+    bool flat = !filenames.empty() and is_flat_file(filenames[0]);
+    TChain *intree = new TChain(flat ? FLAT_TREE_NAME : "Delphes");
+    for (const auto &filename : filenames)
+    {
+        printf("Reading %s\n", filename.c_str());
+        //TFile *infile = new TFile(filename.c_str());
+        intree->Add(filename.c_str());
+    }
+
+    Delphes *indelphes = nullptr;
+    FlatEvent *inflat = nullptr;
+    if (flat) inflat = new FlatEvent(intree);
+    else
+    {
+        indelphes = new Delphes(intree);
+        intree->SetBranchStatus("*", 0);
+        intree->SetBranchStatus("Jet*", 1);
+        intree->SetBranchStatus("Electron*", 1);
+        intree->SetBranchStatus("Muon*", 1);
+        intree->SetBranchStatus("MissingET*", 1);
+        intree->SetBranchStatus("Event", 1);
+        intree->SetBranchStatus("Event.Number", 1);
+        intree->SetBranchStatus("Event.Weight", 1);
+    }
+
+    SelectionV3 selection;
+    if (bootstrap > 0) selection.EnableBootstrap(bootstrap);
+
+    Long64_t first_entry = 0;
+    vector<EntryRange> done;
+    if (resume and read_checkpoint(checkpoint_path, selection, done))
+    {
+        if (done.size() == 1 and done[0].file == infilename.Data())
         {
-            p4_lepton.SetPtEtaPhiM(indelphes->Electron_PT[only_ele], indelphes->Electron_Eta[only_ele], indelphes->Electron_Phi[only_ele], 0.000511);
-            p4_tau.SetPtEtaPhiM(indelphes->Muon_PT[only_mu], indelphes->Muon_Eta[only_mu], indelphes->Muon_Phi[only_mu], 0.10566);
+            first_entry = done[0].last;
+            printf("Resuming from %s at event %lld\n", checkpoint_path.Data(), first_entry);
         }
         else
         {
-            //TLorentzVector p4_muon, p4_electron, p4_met;
-            if (indelphes->Muon_size > 0) p4_muon.SetPtEtaPhiM(indelphes->Muon_PT[0], indelphes->Muon_Eta[0], indelphes->Muon_Phi[0], 0.10566);
-            else p4_muon.SetPtEtaPhiM(0, 0, 0, 0.10566);
-            if (indelphes->Electron_size > 0) p4_electron.SetPtEtaPhiM(indelphes->Electron_PT[0], indelphes->Electron_Eta[0], indelphes->Electron_Phi[0], 0.000511);
-            else p4_electron.SetPtEtaPhiM(0, 0, 0, 0.000511);
-            p4_met.SetPtEtaPhiM(indelphes->MissingET_MET[0], 0, indelphes->MissingET_Phi[0], 0);
-            if (p4_muon.DeltaR(p4_met) < p4_electron.DeltaR(p4_met))
-            {
-                p4_tau.SetPtEtaPhiM(p4_muon.Pt(), p4_muon.Eta(), p4_muon.Phi(), 0.10566);
-                p4_lepton.SetPtEtaPhiM(p4_electron.Pt(), p4_electron.Eta(), p4_electron.Phi(), 0.000511);
-            }
-            else
-            {
-                p4_lepton.SetPtEtaPhiM(p4_muon.Pt(), p4_muon.Eta(), p4_muon.Phi(), 0.10566);
-                p4_tau.SetPtEtaPhiM(p4_electron.Pt(), p4_electron.Eta(), p4_electron.Phi(), 0.000511);
-            }
+            printf("Checkpoint %s is for another input, starting over\n", checkpoint_path.Data());
+            selection.Reset();
         }
-        pT_nu_est = indelphes->MissingET_MET[0] * TMath::Cos(deltaPhi(indelphes->MissingET_Phi[0], p4_tau.Phi()));
-        x_vis_tau = p4_tau.Pt() / (p4_tau.Pt() + pT_nu_est);
-        mass_collinear_etaumu = (p4_tau+p4_lepton).M() / TMath::Sqrt(x_vis_tau);
-
-        for (int i=0; i<23; i++) if (plotthis_etaumu[i]) plots_etaumu.Fill(i);
-        */
+    }
 
-        for (int j=0; j<indelphes->Jet_size; j++)
-        {
-            if (indelphes->Jet_PT[j] < 30) continue;
-            if (TMath::Abs(indelphes->Jet_Eta[j]) > 6.0) continue;
-            passed_jets.push_back(j);
-            if (indelphes->Jet_BTag[j] & 0b111) passed_b_jets.push_back(j);
-        }
-        //if (passed_b_jets.size() == 0) plotthis_etaumu[0] = true;
-        plotthis_etaumu_inclusive[1] = passed_b_jets.size() == 0;
-        plotthis_etaumu_inclusive[2] = plotthis_etaumu_inclusive[1] and passed_jets.size() <= MAX_JETS;
+    // The friend tree needs every entry, so it is only written by a run
+    // starting from the first one
+    TFile *friendfile = nullptr;
+    TTree *friendtree = nullptr;
+    DerivedQuantities derived;
+    if (write_friend and first_entry > 0) printf("Not writing the friend tree of a resumed run\n");
+    else if (write_friend)
+    {
+        friendfile = new TFile(outfilename + ".friend.root", "RECREATE");
+        friendtree = new TTree(FRIEND_TREE_NAME, "derived quantities of the v3 selection");
+        derived.Book(friendtree);
+    }
 
-        for (int njet=0; njet<=MAX_JETS; njet++)
+    Long64_t nentries = intree->GetEntries();
+    int tree = -1;
+    ULong64_t source = 0;
+    for (Long64_t ievent=first_entry; ievent < nentries; ievent++)
+    {
+        if (ievent % 10000 == 0) printf("Reading event %lld\n", ievent);
+        if (intree->LoadTree(ievent) >= 0 and intree->GetTreeNumber() != tree)
         {
-            if (!plotthis_etaumu_inclusive[2]) continue;
-            plotthis_etaumu[njet][0] = passed_jets.size() == njet;
-            if (plotthis_etaumu[njet][0])
-            {
-                electron_vec = find_ele(indelphes, 26, -1);
-                plotthis_etaumu[njet][1] = electron_vec.size() > 0;
-                plotthis_etaumu[njet][2] = electron_vec.size() == 1;
-            }
-            if (plotthis_etaumu[njet][2])
-            {
-                muon_vec = find_mu(indelphes, 10, plotthis_etaumu[njet][6] ? electron_vec[0] : -1);
-                plotthis_etaumu[njet][3] = muon_vec.size() > 0;
-                plotthis_etaumu[njet][4] = muon_vec.size() == 1;
-            }
-            if (plotthis_etaumu[njet][4])
-            {
-                only_mu = muon_vec[0];
-                only_ele = electron_vec[0];
-                plotthis_etaumu[njet][5] = indelphes->Electron_PT[only_ele] > 60;
-            }
-            if (plotthis_etaumu[njet][5])
-            {
-                deltaPhi_mu_met = deltaPhi(indelphes->Muon_Phi[only_mu], indelphes->MissingET_Phi[0]);
-                plotthis_etaumu[njet][6] = deltaPhi_mu_met < 0.7;
-            }
-            if (plotthis_etaumu[njet][6])
-            {
-                deltaPhi_e_mu = deltaPhi(indelphes->Electron_Phi[only_ele], indelphes->Muon_Phi[only_mu]);
-                plotthis_etaumu[njet][7] = deltaPhi_e_mu > 2.2;
-            }
-            if (plotthis_etaumu[njet][7])
-            {
-                plotthis_etaumu[njet][8] = indelphes->Electron_PT[only_ele] > 150 and deltaPhi_mu_met < 0.3;
-                plotthis_etaumu[njet][9] = indelphes->Electron_PT[only_ele] > 60 and deltaPhi_mu_met < 0.7;
-            }
+            tree = intree->GetTreeNumber();
+            source = dedup_source(0, filenames[tree]);
         }
-
-        full_calculate = false;
-        for (int njet=0; njet<=MAX_JETS; njet++) full_calculate = full_calculate or plotthis_etaumu[njet][7];
-
-        if (full_calculate)
+        if (flat)
         {
-            p4_lepton.SetPtEtaPhiM(indelphes->Electron_PT[only_ele], indelphes->Electron_Eta[only_ele], indelphes->Electron_Phi[only_ele], 0.000511);
-            p4_tau.SetPtEtaPhiM(indelphes->Muon_PT[only_mu], indelphes->Muon_Eta[only_mu], indelphes->Muon_Phi[only_mu], 0.10566);
+            inflat->GetEntry(ievent);
+            selection.Process(inflat, source);
+            if (friendtree != nullptr) selection.FillDerived(inflat, derived);
         }
         else
         {
-            //TLorentzVector p4_muon, p4_electron, p4_met;
-            if (indelphes->Muon_size > 0) p4_muon.SetPtEtaPhiM(indelphes->Muon_PT[0], indelphes->Muon_Eta[0], indelphes->Muon_Phi[0], 0.10566);
-            else p4_muon.SetPtEtaPhiM(0, 0, 0, 0.10566);
-            if (indelphes->Electron_size > 0) p4_electron.SetPtEtaPhiM(indelphes->Electron_PT[0], indelphes->Electron_Eta[0], indelphes->Electron_Phi[0], 0.000511);
-            else p4_electron.SetPtEtaPhiM(0, 0, 0, 0.000511);
-            p4_met.SetPtEtaPhiM(indelphes->MissingET_MET[0], 0, indelphes->MissingET_Phi[0], 0);
-            if (p4_muon.DeltaR(p4_met) < p4_electron.DeltaR(p4_met))
-            {
-                p4_tau.SetPtEtaPhiM(p4_muon.Pt(), p4_muon.Eta(), p4_muon.Phi(), 0.10566);
-                p4_lepton.SetPtEtaPhiM(p4_electron.Pt(), p4_electron.Eta(), p4_electron.Phi(), 0.000511);
-            }
-            else
-            {
-                p4_lepton.SetPtEtaPhiM(p4_muon.Pt(), p4_muon.Eta(), p4_muon.Phi(), 0.10566);
-                p4_tau.SetPtEtaPhiM(p4_electron.Pt(), p4_electron.Eta(), p4_electron.Phi(), 0.000511);
-            }
+            indelphes->GetEntry(ievent);
+            selection.Process(indelphes, source);
+            if (friendtree != nullptr) selection.FillDerived(indelphes, derived);
         }
+        if (friendtree != nullptr) friendtree->Fill();
 
-        pT_nu_est = indelphes->MissingET_MET[0] * TMath::Cos(deltaPhi(indelphes->MissingET_Phi[0], p4_tau.Phi()));
-        x_vis_tau = p4_tau.Pt() / (p4_tau.Pt() + pT_nu_est);
-        mass_collinear_etaumu = (p4_tau+p4_lepton).M() / TMath::Sqrt(x_vis_tau);
-
-        for (int i=0; i<3; i++) if (plotthis_etaumu_inclusive[i]) plots_etaumu.Fill(histogram_numbers_etaumu_inclusive[i]);
-        for (int j=0; j<=MAX_JETS; j++)
+        if (checkpoint_every > 0 and (ievent + 1) % checkpoint_every == 0 and ievent + 1 < nentries)
         {
-            for (int i=0; i<10; i++) if (plotthis_etaumu[j][i]) plots_etaumu.Fill(histogram_numbers_etaumu[j][i]);
+            write_checkpoint(checkpoint_path, selection, {{infilename.Data(), 0, ievent + 1}});
         }
     }
 
+    // A skim normalises with the weights of its whole input
+    for (const auto &filename : filenames) selection.AddSkippedWeight(skim_dropped_weight(filename));
+
+    if (friendfile != nullptr)
+    {
+        friendfile->cd();
+        friendtree->Write();
+        friendfile->Close();
+    }
+
     TFile *outfile = new TFile(outfilename, "RECREATE");
-    plots_mutaue.SaveAll(outfile);
-    plots_etaumu.SaveAll(outfile);
+    selection.SaveAll(outfile);
     outfile->Close();
-}
\ No newline at end of file
+    if (checkpoint_every > 0 or resume) gSystem->Unlink(checkpoint_path);
+}
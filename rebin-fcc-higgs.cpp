@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <TChain.h>
+#include <TH1D.h>
+#include <TStopwatch.h>
+#include "read-fcc-higgs-v3.cpp"
+
+using namespace std;
+
+/*
+Makes the final category histograms (mutau_e_lowmass_0j, ...) with a new
+binning from the unbinned events (fcc-higgs-unbinned.h) that the v3 macro,
+the workers and the engine store next to their histograms:
+
+    root -l -b -q "rebin-fcc-higgs.cpp(\"hists_*.root\", \"rebinned.root\", \"bins=40:0:2000\")"
+
+INPUT is a glob of their outputs, all summed. Options (space separated):
+    bins=N:LO:HI      N equal bins (default HIST_BINS:HIST_START:HIST_END)
+    edges=E0,E1,...   variable bins instead
+    window=LO:HI      only events with LO <= mass < HI
+    scale=F           multiply every weight by F, e.g. the luminosity scale
+                      of post_process
+
+The histograms keep the names of the cut flow ones, so they drop into
+post_process and makecard.py in place of the originals.
+*/
+
+void rebin_fcc_higgs(TString infilename, TString outfilename, TString options = "")
+{
+    gErrorIgnoreLevel = kFatal;
+    TH1::AddDirectory(kFALSE);
+
+    int bins = HIST_BINS;
+    double lo = HIST_START;
+    double hi = HIST_END;
+    vector<double> edges;
+    double window_lo = -1e300;
+    double window_hi = 1e300;
+    double scale = 1;
+    istringstream tokens(options.Data());
+    string token;
+    while (tokens >> token)
+    {
+        size_t eq = token.find('=');
+        string key = token.substr(0, eq);
+        string value = eq == string::npos ? "" : token.substr(eq + 1);
+        if (key == "bins") sscanf(value.c_str(), "%d:%lf:%lf", &bins, &lo, &hi);
+        else if (key == "scale") scale = atof(value.c_str());
+        else if (key == "window") sscanf(value.c_str(), "%lf:%lf", &window_lo, &window_hi);
+        else if (key == "edges")
+        {
+            istringstream items(value);
+            string item;
+            while (getline(items, item, ',')) edges.push_back(atof(item.c_str()));
+        }
+        else printf("Unknown option %s\n", token.c_str());
+    }
+    if (!edges.empty() and edges.size() < 2)
+    {
+        printf("edges needs at least two values\n");
+        return;
+    }
+
+    TStopwatch timer;
+    timer.Start();
+    TChain chain(SELECTED_TREE_NAME);
+    for (const auto &filename : glob(infilename.Data()))
+    {
+        printf("Reading %s\n", filename.c_str());
+        chain.Add(filename.c_str());
+    }
+    vector<SelectedEvent> events;
+    read_selected_events(&chain, events);
+
+    // Indexed by (channel, highmass, njet)
+    const int njets = MAX_JETS + 1;
+    vector<TH1D *> hists;
+    for (int channel=0; channel<DECISION_NCHANNELS; channel++)
+    {
+        for (int highmass=0; highmass<2; highmass++)
+        {
+            for (int njet=0; njet<njets; njet++)
+            {
+                TString name = selected_hist_name(channel, highmass, njet);
+                if (edges.empty()) hists.push_back(new TH1D(name, name, bins, lo, hi));
+                else hists.push_back(new TH1D(name, name, edges.size() - 1, edges.data()));
+            }
+        }
+    }
+    Long64_t kept = 0;
+    for (const auto &event : events)
+    {
+        if (event.mass < window_lo or event.mass >= window_hi) continue;
+        if (event.channel >= DECISION_NCHANNELS or event.highmass > 1 or event.njet >= njets) continue;
+        hists[(event.channel * 2 + event.highmass) * njets + event.njet]->Fill(event.mass, scale * event.weight);
+        kept++;
+    }
+
+    TFile *outfile = new TFile(outfilename, "RECREATE");
+    for (TH1D *hist : hists) hist->Write();
+    outfile->Close();
+    timer.Stop();
+    printf("Filled %lld of %zu events into %zu histograms in %.3f s\n", kept, events.size(), hists.size(), timer.RealTime());
+}
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <TH1D.h>
+#include <TStopwatch.h>
+#include "run-fcc-higgs.cpp"
+
+using namespace std;
+
+/*
+Fills a histogram from the decision bits written by run_fcc_higgs with the
+option decisions (fcc-higgs-decisions.h), reading only the events that
+pass, without running the cut flow again:
+
+    root -l -b -q "run-fcc-higgs.cpp(\"INPUT\", \"hists.root\", \"decisions\")"
+    root -l -b -q "replot-fcc-higgs.cpp(\"hists.root.decisions.root\", \"replot.root\", \"select=mutau_e_step07_1j var=mu_pt\")"
+
+options (space separated):
+    select=NAME   events entering the cut flow histogram NAME, e.g.
+                  mutau_e_step07_1j (default mutau_e_lowmass_0j)
+    nminus1=CUT   instead, events of the category of select (highmass or
+                  lowmass, and its jet bin) passing all of its cuts but CUT,
+                  one of the CUT_NAMES, e.g. dphi_emu
+    var=NAME      mu_pt, el_pt (leading muon, electron), met, dphi_e_met,
+                  dphi_mu_met, dphi_e_mu, njet (jets with pT > 30 GeV and
+                  |eta| < 6, as in the jet bins) or mass (collinear mass of
+                  the channel, as in the cut flow histograms); default mass
+    bins=N:LO:HI  binning (default 20:0:1500)
+
+Events are filled with their weight (Event.Weight), as in the cut flow.
+
+The input files must still be where run_fcc_higgs read them.
+*/
+
+template <class Event>
+double replot_value(const string &var, Event *event, SelectionV3 &selection, int channel)
+{
+    int mu = -1;
+    int el = -1;
+    for (int i=0; i<event->Muon_size; i++) if (mu < 0 or event->Muon_PT[i] > event->Muon_PT[mu]) mu = i;
+    for (int i=0; i<event->Electron_size; i++) if (el < 0 or event->Electron_PT[i] > event->Electron_PT[el]) el = i;
+    if (var == "mu_pt") return mu < 0 ? 0 : event->Muon_PT[mu];
+    if (var == "el_pt") return el < 0 ? 0 : event->Electron_PT[el];
+    if (var == "met") return event->MissingET_MET[0];
+    if (var == "dphi_e_met") return el < 0 ? 0 : deltaPhi(event->Electron_Phi[el], event->MissingET_Phi[0]);
+    if (var == "dphi_mu_met") return mu < 0 ? 0 : deltaPhi(event->Muon_Phi[mu], event->MissingET_Phi[0]);
+    if (var == "dphi_e_mu") return mu < 0 or el < 0 ? 0 : deltaPhi(event->Electron_Phi[el], event->Muon_Phi[mu]);
+    if (var == "njet")
+    {
+        // The jets the selection counts, not every Delphes jet
+        EventObjects objects;
+        objects.Fill(event);
+        return objects.jets.size();
+    }
+    selection.Process(event);
+    return selection.MassCollinear(channel);
+}
+
+void replot_fcc_higgs(TString decisionsname, TString outfilename, TString options = "")
+{
+    gErrorIgnoreLevel = kFatal;
+    TH1::AddDirectory(kFALSE);
+
+    string select = "mutau_e_lowmass_0j";
+    string nminus1;
+    string var = "mass";
+    int bins = HIST_BINS;
+    double lo = HIST_START;
+    double hi = HIST_END;
+    istringstream tokens(options.Data());
+    string token;
+    while (tokens >> token)
+    {
+        size_t eq = token.find('=');
+        string key = token.substr(0, eq);
+        string value = eq == string::npos ? "" : token.substr(eq + 1);
+        if (key == "select") select = value;
+        else if (key == "nminus1") nminus1 = value;
+        else if (key == "var") var = value;
+        else if (key == "bins") sscanf(value.c_str(), "%d:%lf:%lf", &bins, &lo, &hi);
+        else printf("Unknown option %s\n", token.c_str());
+    }
+
+    SelectionV3 selection;
+    int channel = 0;
+    int bit = selection.StepBit(select.c_str(), channel);
+    if (bit < 0)
+    {
+        printf("Unknown histogram %s\n", select.c_str());
+        return;
+    }
+    // Category and jet bin of select for N-1
+    ULong64_t cut_mask = 0;
+    int excluded = -1;
+    int njet = -1;
+    if (!nminus1.empty())
+    {
+        excluded = cut_bit(nminus1);
+        size_t category = select.find("mass_");
+        if (excluded < 0 or category == string::npos)
+        {
+            printf("nminus1 needs a cut name and a highmass or lowmass histogram\n");
+            return;
+        }
+        cut_mask = select.find("highmass") != string::npos ? CUTS_HIGHMASS : CUTS_LOWMASS;
+        cut_mask &= ~(1ULL << excluded);
+        njet = atoi(select.c_str() + category + 5);
+    }
+
+    vector<string> files;
+    vector<DecisionRecord> records;
+    if (!read_decisions(decisionsname, files, records))
+    {
+        printf("Cannot read decisions from %s\n", decisionsname.Data());
+        return;
+    }
+
+    TString histname = nminus1.empty() ? Form("%s_%s", select.c_str(), var.c_str()) : Form("%s_nminus1_%s_%s", select.c_str(), nminus1.c_str(), var.c_str());
+    TH1D *hist = new TH1D(histname, histname, bins, lo, hi);
+
+    TStopwatch timer;
+    timer.Start();
+    Long64_t selected = 0;
+    size_t r = 0;
+    while (r < records.size())
+    {
+        // Selected entries of one file, in order
+        int file = records[r].file;
+        vector<Long64_t> entries;
+        for (; r < records.size() and records[r].file == file; r++)
+        {
+            const DecisionRecord &record = records[r];
+            bool pass = nminus1.empty() ? (record.steps[channel] >> bit) & 1 : (record.cuts[channel] & cut_mask) == cut_mask and record.njet == njet;
+            if (pass) entries.push_back(record.entry);
+        }
+        if (entries.empty()) continue;
+
+        InputReader reader;
+        if (!reader.Open(files[file]))
+        {
+            printf("Cannot read %s, skipping %zu events\n", files[file].c_str(), entries.size());
+            continue;
+        }
+        printf("Reading %zu events of %s\n", entries.size(), files[file].c_str());
+        reader.Visit([&](auto *event)
+        {
+            for (Long64_t entry : entries)
+            {
+                event->GetEntry(entry);
+                hist->Fill(replot_value(var, event, selection, channel), event->Event_Weight[0]);
+            }
+        });
+        selected += entries.size();
+    }
+    timer.Stop();
+
+    TFile *outfile = new TFile(outfilename, "RECREATE");
+    hist->Write();
+    outfile->Close();
+    printf("Filled %s from %lld of %zu recorded events in %.2f s\n", histname.Data(), selected, records.size(), timer.RealTime());
+}
@@ -0,0 +1,1153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <TParameter.h>
+#include <TStopwatch.h>
+#include "read-fcc-higgs-v3.cpp"
+#include "read-fcc-higgs-v2.cpp"
+#include "fcc-higgs-scheduler.h"
+#include "fcc-higgs-checkpoint.h"
+#include "fcc-higgs-colcache.h"
+#include "fcc-higgs-zonemap.h"
+#include "fcc-higgs-universes.h"
+#include "fcc-higgs-samples.h"
+#include "fcc-higgs-dedup.h"
+#include "fcc-higgs-eventindex.h"
+#include "fcc-higgs-metrics.h"
+
+using namespace std;
+
+/*
+Multithreaded driver for the v3 selection.
+
+The input files are cut into chunks aligned to the TTree clusters, and the
+chunks are handed to the worker threads by WorkStealingScheduler, so a few
+large files no longer hold the whole node while the other cores idle.
+Chunk sizes follow the measured events/s (ChunkSizer) so that each chunk
+takes about the target time, and shrink towards the end of the run.
+Every thread has its own reader and SelectionV3, the histograms are merged
+at the end and saved with the same names as read_fcc_higgs_v3. With the
+option v2 the v2 selection is filled in the same pass, with control the
+control regions and with universes the systematic variations
+(EngineSelection).
+
+    root -l -b -q "run-fcc-higgs.cpp(\"INPUT\", \"OUTPUT\", \"threads=20\")"
+
+INPUT is a glob, or @list.txt with one file (or glob) per line, of Delphes
+files, flat skims (fcc-higgs-flat.h) or column caches (fcc-higgs-colcache.h),
+which may be mixed. With the option catalogue it is a sample catalogue
+(fcc-higgs-samples.h) instead, and all its samples run in one pass on the
+same threads, each saved in a directory of OUTPUT (SampleSelection).
+Options are space separated key=value pairs:
+    threads=N   worker threads, 0 (default) uses all cores
+    chunk=N     entries of the first chunks, before any rate is measured
+                (default 10000); all chunks are rounded up to whole clusters
+    target=S    seconds one chunk should take (default 5), 0 keeps every
+                chunk at chunk=N entries
+    speculate=F once the queues are empty, run a second copy of any chunk
+                taking F times longer than expected (default 3, at least
+                10 s), keeping whichever copy finishes first; 0 disables
+    slow=T:S    testing aid, thread T sleeps S seconds before each chunk
+    require=R   only events with R, e.g. lead_mu_pt>150,n_jet<=2 (see
+                fcc-higgs-zonemap.h); zones of skims and column caches
+                whose zone map rules R out are not read at all, all other
+                events are checked one by one, so the histograms only
+                count events passing R; sum_weights still counts every
+                event of the inputs, read or not; an unknown key stops
+                the run
+    checkpoint=S  every S seconds, save the merged histograms and the
+                entry ranges already in them to OUTPUT.checkpoint
+    resume      start from OUTPUT.checkpoint if it exists and only run the
+                entry ranges it does not cover
+    metrics=S   every S seconds (default 10), replace OUTPUT.metrics.json
+                with the progress, rate, reading, memory, cut flow and
+                per-thread state of the run (fcc-higgs-metrics.h); 0
+                disables
+    v2          also fill the v2 selection from the same read of every
+                event, saved with the names of read_fcc_higgs_v2 in the
+                directory v2 of OUTPUT. v2 has no lepton veto, so the run
+                refuses it on skims and on column caches that left events
+                out (the veto of make-column-cache.cpp, or skim sources)
+    control     also fill the v3 cut flow in the control regions
+                (CONTROL_REGIONS: same-sign e mu, 1+ b-jet, 3+ jets), each
+                saved in its own directory of OUTPUT
+    bootstrap=N also fill N Poisson bootstrap replicas of every histogram
+                of the signal region, saved as NAME_bootstrap
+                (fcc-higgs-bootstrap.h)
+    universes=V also fill the v3 cut flow of the signal region for each
+                systematic variation in V, a comma separated subset of
+                VARIATIONS (fcc-higgs-universes.h) or all, each saved in a
+                directory of OUTPUT named after it
+    dedup       drop events read before from another file of the same
+                production seed (fcc-higgs-dedup.h), e.g. a rerun seed,
+                before the selection; OUTPUT.duplicates.tsv lists the
+                dropped events per file, and their weights are taken off
+                the sums of weights of the catalogue; with resume, the
+                events of the restored ranges are read into the check
+                again first, the duplicates among them counted as before
+    catalogue   INPUT is a sample catalogue
+    samples=S   only run the samples of the catalogue in S, a comma
+                separated list of sample names or processes, e.g. a new
+                production ttbar_hvq/hvqMulti10M_set3 to stitch to the
+                others with stitch-fcc-higgs.cpp
+    lumi=L      luminosity in pb^-1 the samples of a catalogue are scaled
+                to (default 3e7, 30 ab^-1)
+    decisions   also write the decision bits of every event passing the
+                lepton veto to OUTPUT.decisions.root (fcc-higgs-decisions.h),
+                for replot-fcc-higgs.cpp; ranges restored from a checkpoint
+                have none
+    events      also write the file, entry and Event.Number of every event
+                of the final categories of the signal region to
+                OUTPUT.events.root (fcc-higgs-eventindex.h), to find it
+                again for an event dump; ranges restored from a checkpoint
+                have none
+
+Besides OUTPUT, OUTPUT.timing.tsv lists per input file the entries and
+the thread-seconds spent on it, and OUTPUT.chunks.tsv every kept chunk with
+the thread that ran it, its duration and how many of its events made it
+into a final category of the signal region. While the run goes on, every
+thread appends its chunks to a record of its own, OUTPUT.chunks.W.tsv,
+flushed after each chunk and written outside of any lock; pyinterface.py
+(run_monitored) sums them per thread for the progress of the run, and at
+the end they are concatenated into OUTPUT.chunks.tsv.
+*/
+
+const char *CHUNK_RECORD_HEADER = "thread\tfile\tfirst\tlast\tentries\tseconds\tevents_per_s\tspeculative\tselected\n";
+
+struct RunOptions
+{
+    int threads = 0;
+    Long64_t chunk_entries = 10000;
+    double target_seconds = 5;
+    double speculate = 3;
+    int slow_thread = -1;
+    double slow_seconds = 0;
+    double checkpoint_seconds = 0;
+    double metrics_seconds = 10;
+    bool resume = false;
+    bool flat = false;
+    bool decisions = false;
+    bool events = false;
+    bool dedup = false;
+    bool v2 = false;
+    bool control = false;
+    bool catalogue = false;
+    vector<string> sample_names;
+    double lumi = 3e7;
+    vector<Variation> variations;
+    int bootstrap = 0;
+    vector<Requirement> requirements;
+};
+
+RunOptions parse_options(TString options)
+{
+    RunOptions opt;
+    istringstream tokens(options.Data());
+    string token;
+    while (tokens >> token)
+    {
+        size_t eq = token.find('=');
+        string key = token.substr(0, eq);
+        string value = eq == string::npos ? "" : token.substr(eq + 1);
+        if (key == "threads") opt.threads = atoi(value.c_str());
+        else if (key == "chunk") opt.chunk_entries = atoll(value.c_str());
+        else if (key == "target") opt.target_seconds = atof(value.c_str());
+        else if (key == "speculate") opt.speculate = atof(value.c_str());
+        else if (key == "checkpoint") opt.checkpoint_seconds = atof(value.c_str());
+        else if (key == "metrics") opt.metrics_seconds = atof(value.c_str());
+        else if (key == "resume") opt.resume = true;
+        else if (key == "flat") opt.flat = true;
+        else if (key == "decisions") opt.decisions = true;
+        else if (key == "events") opt.events = true;
+        else if (key == "dedup") opt.dedup = true;
+        else if (key == "v2") opt.v2 = true;
+        else if (key == "control") opt.control = true;
+        else if (key == "catalogue") opt.catalogue = true;
+        else if (key == "samples")
+        {
+            istringstream names(value);
+            string name;
+            while (getline(names, name, ',')) if (!name.empty()) opt.sample_names.push_back(name);
+        }
+        else if (key == "lumi") opt.lumi = atof(value.c_str());
+        else if (key == "universes") opt.variations = parse_variations(value);
+        else if (key == "bootstrap") opt.bootstrap = atoi(value.c_str());
+        else if (key == "require")
+        {
+            // Running without a requirement would fill events it was meant to exclude
+            bool valid = true;
+            opt.requirements = parse_requirements(value, valid);
+            if (!valid) gSystem->Exit(1);
+        }
+        else if (key == "slow")
+        {
+            opt.slow_thread = atoi(value.c_str());
+            size_t colon = value.find(':');
+            opt.slow_seconds = colon == string::npos ? 10 : atof(value.c_str() + colon + 1);
+        }
+        else printf("Unknown option %s\n", token.c_str());
+    }
+    if (opt.threads <= 0) opt.threads = thread::hardware_concurrency();
+    if (opt.threads <= 0) opt.threads = 1;
+    if (opt.chunk_entries <= 0) opt.chunk_entries = 1;
+    return opt;
+}
+
+vector<string> expand_inputs(TString infilename)
+{
+    vector<string> files;
+    if (!infilename.BeginsWith("@"))
+    {
+        return glob(infilename.Data());
+    }
+    ifstream list(infilename.Data() + 1);
+    string line;
+    while (getline(list, line))
+    {
+        if (line.empty() or line[0] == '#') continue;
+        for (const auto &filename : glob(line.c_str())) files.push_back(filename);
+    }
+    return files;
+}
+
+// The (exclusive) last entry of every cluster of tree
+vector<long long> tree_cluster_ends(TTree *tree)
+{
+    Long64_t nentries = tree->GetEntries();
+    vector<long long> cluster_ends;
+    TTree::TClusterIterator clusters = tree->GetClusterIterator(0);
+    while (clusters() < nentries) cluster_ends.push_back(TMath::Min(clusters.GetNextEntry(), nentries));
+    return cluster_ends;
+}
+
+// One span per file, with the cluster layout handed to the scheduler; files
+// that cannot be read go to unreadable
+vector<Chunk> plan_spans(const vector<string> &files, WorkStealingScheduler &scheduler, vector<Long64_t> &file_entries, vector<string> &unreadable)
+{
+    vector<Chunk> spans;
+    file_entries.assign(files.size(), 0);
+    for (size_t i=0; i<files.size(); i++)
+    {
+        // Column caches have no clusters, chunks may end anywhere
+        if (is_column_cache(files[i]))
+        {
+            MappedColumns columns(files[i]);
+            file_entries[i] = columns.Entries();
+            for (const auto &stale : columns.StaleSources()) printf("Warning: %s changed since %s was made\n", stale.c_str(), files[i].c_str());
+            if (columns.Entries() > 0) spans.push_back({(int) i, 0, columns.Entries()});
+            continue;
+        }
+
+        TFile *infile = TFile::Open(files[i].c_str());
+        TTree *tree = nullptr;
+        if (infile != nullptr and !infile->IsZombie()) infile->GetObject("Delphes", tree);
+        if (infile != nullptr and tree == nullptr) infile->GetObject(FLAT_TREE_NAME, tree);
+        if (tree == nullptr)
+        {
+            printf("Cannot read Delphes tree from %s\n", files[i].c_str());
+            unreadable.push_back(files[i]);
+            delete infile;
+            continue;
+        }
+
+        Long64_t nentries = tree->GetEntries();
+        file_entries[i] = nentries;
+        scheduler.SetClusters(i, tree_cluster_ends(tree));
+        if (nentries > 0) spans.push_back({(int) i, 0, nentries});
+        delete infile;
+    }
+    return spans;
+}
+
+// True for a skim, or a column cache that left events of its sources out:
+// only events passing the lepton veto of v3 are in there
+bool is_vetoed_input(const string &filename)
+{
+    if (is_column_cache(filename))
+    {
+        MappedColumns columns(filename);
+        for (UInt_t s=0; s<columns.NSources(); s++) if (columns.Source(s).dropped_weight != 0) return true;
+        return false;
+    }
+    TFile *infile = TFile::Open(filename.c_str());
+    bool skim = infile != nullptr and !infile->IsZombie() and infile->Get("skim_input_sum_weights") != nullptr;
+    delete infile;
+    return skim;
+}
+
+// Zone map of a skim or column cache, false if it has none
+bool load_zone_map(const string &filename, vector<Zone> &zones)
+{
+    if (is_column_cache(filename)) return read_zone_map(MappedColumns(filename), zones);
+    TFile *infile = TFile::Open(filename.c_str());
+    bool found = infile != nullptr and !infile->IsZombie() and read_zone_map(infile, zones);
+    delete infile;
+    return found;
+}
+
+// Drop the parts of the spans in zones where no event can pass the
+// requirements, listed in ruled_out; files without zone map are kept whole
+vector<Chunk> skip_zones(const vector<Chunk> &spans, const vector<string> &files, const vector<Requirement> &requirements, Long64_t &skipped,
+                         vector<Chunk> &ruled_out)
+{
+    skipped = 0;
+    if (requirements.empty()) return spans;
+    vector<Chunk> remaining;
+    map<int, vector<Zone>> zone_maps;
+    for (const Chunk &span : spans)
+    {
+        if (zone_maps.count(span.file) == 0 and !load_zone_map(files[span.file], zone_maps[span.file]))
+        {
+            printf("No zone map in %s, reading all of it\n", files[span.file].c_str());
+        }
+        const vector<Zone> &zones = zone_maps[span.file];
+        if (zones.empty())
+        {
+            remaining.push_back(span);
+            continue;
+        }
+        // Entries outside of every zone are kept, to be safe
+        Long64_t next = span.first;
+        for (const Zone &zone : zones)
+        {
+            Long64_t first = TMath::Max(zone.first, span.first);
+            Long64_t last = TMath::Min(zone.last, span.last);
+            if (first >= last or zone_may_pass(requirements, zone)) continue;
+            if (first > next) remaining.push_back({span.file, next, first});
+            ruled_out.push_back({span.file, first, last});
+            skipped += last - first;
+            next = last;
+        }
+        if (next < span.last) remaining.push_back({span.file, next, span.last});
+    }
+    return remaining;
+}
+
+// Remove the already finished ranges from the per-file spans
+vector<Chunk> subtract_done(const vector<Chunk> &spans, const vector<string> &files, const vector<EntryRange> &done)
+{
+    vector<Chunk> remaining;
+    for (const Chunk &span : spans)
+    {
+        vector<pair<Long64_t, Long64_t>> covered;
+        for (const auto &range : done)
+        {
+            if (range.file == files[span.file]) covered.push_back({range.first, range.last});
+        }
+        sort(covered.begin(), covered.end());
+        Long64_t next = span.first;
+        for (const auto &range : covered)
+        {
+            if (range.first > next) remaining.push_back({span.file, next, TMath::Min(range.first, span.last)});
+            next = TMath::Max(next, range.second);
+        }
+        if (next < span.last) remaining.push_back({span.file, next, span.last});
+    }
+    return remaining;
+}
+
+/*
+The selections of the engine: v3 in the signal region, and if asked for
+v2, v3 in the control regions and v3 in the systematic universes, all fed
+from one read per event. The nominal selections share one object stage
+(EventObjects); every universe runs on its own shifted copy of the event
+(fcc-higgs-universes.h). The signal region is saved at the top of the
+output as always; v2, every control region and every universe go in a
+directory of their own ("v2", Region::name, Variation::name) with the
+usual histogram names, so they all come at the cost of one pass.
+*/
+class EngineSelection
+{
+    public:
+        EngineSelection(const RunOptions &opt) : variations(opt.variations)
+        {
+            if (opt.bootstrap > 0) v3.EnableBootstrap(opt.bootstrap);
+            if (opt.v2) v2 = new SelectionV2();
+            if (opt.control) for (const auto &region : CONTROL_REGIONS) control.push_back(new SelectionV3(region));
+            for (size_t u=0; u<variations.size(); u++) universes.push_back(new SelectionV3());
+        }
+        EngineSelection(const EngineSelection &) = delete;
+        ~EngineSelection()
+        {
+            delete v2;
+            for (SelectionV3 *selection : control) delete selection;
+            for (SelectionV3 *selection : universes) delete selection;
+        }
+
+        // source (fcc-higgs-dedup.h) seeds the bootstrap weights
+        template <class Event>
+        void Process(Event *event, ULong64_t source = 0)
+        {
+            objects.Clear();
+            v3.Process(event, objects, source);
+            if (v2 != nullptr) v2->Process(event, objects);
+            for (SelectionV3 *selection : control) selection->Process(event, objects, source);
+            if (!universes.empty()) shifted.CopyFrom(event);
+            for (size_t u=0; u<universes.size(); u++)
+            {
+                shift_kinematics(shifted, event, variations[u]);
+                shifted_objects.Clear();
+                universes[u]->Process(&shifted, shifted_objects, source);
+            }
+        }
+        void Reset()
+        {
+            v3.Reset();
+            if (v2 != nullptr) v2->Reset();
+            for (SelectionV3 *selection : control) selection->Reset();
+            for (SelectionV3 *selection : universes) selection->Reset();
+        }
+        void Add(const EngineSelection &other)
+        {
+            v3.Add(other.v3);
+            if (v2 != nullptr and other.v2 != nullptr) v2->Add(*other.v2);
+            for (size_t i=0; i<control.size() and i<other.control.size(); i++) control[i]->Add(*other.control[i]);
+            for (size_t u=0; u<universes.size() and u<other.universes.size(); u++) universes[u]->Add(*other.universes[u]);
+        }
+        // See SelectionV3::SkipEvent and AddSkippedWeight
+        void SkipEvent(double weight)
+        {
+            v3.SkipEvent(weight);
+            for (SelectionV3 *selection : control) selection->SkipEvent(weight);
+            for (SelectionV3 *selection : universes) selection->SkipEvent(weight);
+        }
+        void AddSkippedWeight(double weight)
+        {
+            v3.AddSkippedWeight(weight);
+            for (SelectionV3 *selection : control) selection->AddSkippedWeight(weight);
+            for (SelectionV3 *selection : universes) selection->AddSkippedWeight(weight);
+        }
+        void Scale(double factor)
+        {
+            v3.Scale(factor);
+            if (v2 != nullptr) v2->Scale(factor);
+            for (SelectionV3 *selection : control) selection->Scale(factor);
+            for (SelectionV3 *selection : universes) selection->Scale(factor);
+        }
+        void SaveAll(TDirectory *outfile)
+        {
+            v3.SaveAll(outfile);
+            if (v2 != nullptr) v2->SaveAll(outfile->mkdir("v2"));
+            for (SelectionV3 *selection : control) selection->SaveAll(outfile->mkdir(selection->region.name));
+            for (size_t u=0; u<universes.size(); u++) universes[u]->SaveAll(outfile->mkdir(variations[u].name));
+        }
+        void LoadAll(TDirectory *infile)
+        {
+            v3.LoadAll(infile);
+            TDirectory *dir = infile->GetDirectory("v2");
+            if (v2 != nullptr and dir != nullptr) v2->LoadAll(dir);
+            for (SelectionV3 *selection : control)
+            {
+                dir = infile->GetDirectory(selection->region.name);
+                if (dir != nullptr) selection->LoadAll(dir);
+            }
+            for (size_t u=0; u<universes.size(); u++)
+            {
+                dir = infile->GetDirectory(variations[u].name);
+                if (dir != nullptr) universes[u]->LoadAll(dir);
+            }
+        }
+
+        SelectionV3 v3;
+        SelectionV2 *v2 = nullptr;
+        vector<SelectionV3 *> control;
+        const vector<Variation> variations;
+        vector<SelectionV3 *> universes;
+
+    private:
+        EventObjects objects;
+        FlatEvent shifted;
+        EventObjects shifted_objects;
+};
+
+// Scales selection to lumi * cross_section / sum_weights and saves it in
+// dir, with the factor, cross-section and sum of weights as parameters;
+// the latter is norm_sum_weights, as sum_weights is the v3 histogram
+void save_scaled(TDirectory *dir, EngineSelection &selection, const char *name, double lumi, double cross_section, double sum_weights)
+{
+    double scale = sum_weights == 0 ? 0 : lumi * cross_section / sum_weights;
+    printf("Sample %s: sum of weights %g, cross-section %g pb, scale %g\n", name, sum_weights, cross_section, scale);
+    selection.Scale(scale);
+    selection.SaveAll(dir);
+    TParameter<double> scale_parameter("scale", scale);
+    TParameter<double> cross_section_parameter("cross_section", cross_section);
+    TParameter<double> sum_weights_parameter("norm_sum_weights", sum_weights);
+    dir->WriteTObject(&scale_parameter);
+    dir->WriteTObject(&cross_section_parameter);
+    dir->WriteTObject(&sum_weights_parameter);
+}
+
+/*
+The EngineSelection of every sample of a run. A run without catalogue has
+one unnamed sample, saved at the top of the output as before. Checkpoints
+hold the unscaled histograms; SaveScaled() scales each sample to lumi *
+cross-section / sum of weights for the final output, and records the
+factor as the parameter "scale" next to the histograms of the sample. The
+sum of weights is the one of the dataset catalogue where it is known and
+current, else sum_weights of the v3 selection, i.e. of the events read.
+The components PROCESS/COMPONENT of a process (fcc-higgs-samples.h) are
+also summed unscaled and saved in PROCESS, scaled by lumi * cross-section
+over their summed sums of weights, which weights every component by its
+share of the luminosity.
+*/
+class SampleSelection
+{
+    public:
+        SampleSelection(const RunOptions &opt, const vector<Sample> &samples) : opt(opt), samples(samples)
+        {
+            for (size_t s=0; s<samples.size(); s++) selections.push_back(new EngineSelection(opt));
+        }
+        SampleSelection(const SampleSelection &) = delete;
+        ~SampleSelection()
+        {
+            for (EngineSelection *selection : selections) delete selection;
+        }
+
+        EngineSelection &operator[](int sample) { return *selections[sample]; }
+
+        void Reset()
+        {
+            for (EngineSelection *selection : selections) selection->Reset();
+        }
+        void Add(const SampleSelection &other)
+        {
+            for (size_t s=0; s<selections.size() and s<other.selections.size(); s++) selections[s]->Add(*other.selections[s]);
+        }
+        void SaveAll(TDirectory *outfile)
+        {
+            for (size_t s=0; s<selections.size(); s++) selections[s]->SaveAll(Directory(outfile, s));
+        }
+        void LoadAll(TDirectory *infile)
+        {
+            for (size_t s=0; s<selections.size(); s++)
+            {
+                TDirectory *dir = samples[s].name.empty() ? infile : infile->GetDirectory(samples[s].name.c_str());
+                if (dir != nullptr) selections[s]->LoadAll(dir);
+            }
+        }
+        void SaveScaled(TDirectory *outfile, double lumi)
+        {
+            // Stitch the components before each of them gets scaled
+            vector<string> processes;
+            for (const auto &sample : samples)
+            {
+                string process = sample_process(sample.name);
+                if (!process.empty() and find(processes.begin(), processes.end(), process) == processes.end()) processes.push_back(process);
+            }
+            for (const string &process : processes)
+            {
+                EngineSelection stitched(opt);
+                double cross_section = 0;
+                double sum_weights = 0;
+                for (size_t s=0; s<samples.size(); s++)
+                {
+                    if (sample_process(samples[s].name) != process) continue;
+                    stitched.Add(*selections[s]);
+                    cross_section = samples[s].cross_section;
+                    sum_weights += SumWeights(s);
+                }
+                save_scaled(outfile->mkdir(process.c_str()), stitched, process.c_str(), lumi, cross_section, sum_weights);
+            }
+            for (size_t s=0; s<selections.size(); s++)
+            {
+                if (samples[s].name.empty()) selections[s]->SaveAll(outfile);
+                else save_scaled(Directory(outfile, s), *selections[s], samples[s].name.c_str(), lumi, samples[s].cross_section, SumWeights(s));
+            }
+        }
+
+        // Takes weight, of events dropped as duplicates, off the catalogue
+        // sum of weights of sample, which counts them
+        void DropWeight(int sample, double weight)
+        {
+            if (samples[sample].known) samples[sample].sum_weights -= weight;
+        }
+
+    private:
+        double SumWeights(size_t s)
+        {
+            return samples[s].known ? samples[s].sum_weights : selections[s]->v3.sum_weights->GetBinContent(1);
+        }
+
+        TDirectory *Directory(TDirectory *outfile, size_t s)
+        {
+            if (samples[s].name.empty()) return outfile;
+            string process = sample_process(samples[s].name);
+            if (process.empty()) return outfile->mkdir(samples[s].name.c_str());
+            TDirectory *parent = outfile->GetDirectory(process.c_str());
+            if (parent == nullptr) parent = outfile->mkdir(process.c_str());
+            return parent->mkdir(samples[s].name.c_str() + process.size() + 1);
+        }
+
+        const RunOptions opt;
+        vector<Sample> samples;
+        vector<EngineSelection *> selections;
+};
+
+/*
+Reader for one input file, whichever its layout: a Delphes file, a flat
+skim (fcc-higgs-flat.h) or a column cache (fcc-higgs-colcache.h). Visit()
+calls f with the open reader, so the same event loop serves all three.
+*/
+class InputReader
+{
+    public:
+        InputReader() { }
+        InputReader(const InputReader &) = delete;
+        ~InputReader() { Close(); }
+
+        bool Open(const string &filename)
+        {
+            Close();
+            if (is_column_cache(filename))
+            {
+                mapped = new MappedEvent(filename);
+                if (!mapped->IsValid()) Close();
+                return IsOpen();
+            }
+
+            TFile *infile = TFile::Open(filename.c_str());
+            TTree *tree = nullptr;
+            if (infile == nullptr or infile->IsZombie())
+            {
+                delete infile;
+                return false;
+            }
+            infile->GetObject(FLAT_TREE_NAME, tree);
+            if (tree != nullptr)
+            {
+                flat = new FlatEvent(tree);
+                return true;
+            }
+            infile->GetObject("Delphes", tree);
+            if (tree == nullptr)
+            {
+                delete infile;
+                return false;
+            }
+            // Delphes takes ownership of the file and closes it in its destructor
+            delphes = new Delphes(tree);
+            tree->SetBranchStatus("*", 0);
+            tree->SetBranchStatus("Jet*", 1);
+            tree->SetBranchStatus("Electron*", 1);
+            tree->SetBranchStatus("Muon*", 1);
+            tree->SetBranchStatus("MissingET*", 1);
+            tree->SetBranchStatus("Event", 1);
+            tree->SetBranchStatus("Event.Number", 1);
+            tree->SetBranchStatus("Event.Weight", 1);
+            return true;
+        }
+
+        void Close()
+        {
+            delete delphes;
+            delete flat;
+            delete mapped;
+            delphes = nullptr;
+            flat = nullptr;
+            mapped = nullptr;
+        }
+
+        bool IsOpen() const { return delphes != nullptr or flat != nullptr or mapped != nullptr; }
+
+        Long64_t Entries() const
+        {
+            if (delphes != nullptr) return delphes->fChain->GetEntries();
+            if (flat != nullptr) return flat->fChain->GetEntries();
+            if (mapped != nullptr) return mapped->GetEntries();
+            return 0;
+        }
+
+        template <class F>
+        void Visit(F f)
+        {
+            if (delphes != nullptr) f(delphes);
+            else if (flat != nullptr) f(flat);
+            else if (mapped != nullptr) f(mapped);
+        }
+
+    private:
+        Delphes *delphes = nullptr;
+        FlatEvent *flat = nullptr;
+        MappedEvent *mapped = nullptr;
+};
+
+// Puts the events of the ranges restored from a checkpoint back into the
+// duplicate check; those seen before were dropped by the interrupted run,
+// so they are counted again as duplicates
+void restore_duplicates(DuplicateFilter &duplicates, const vector<string> &files, const vector<ULong64_t> &file_source, const vector<int> &file_sample,
+                        const vector<EntryRange> &done, vector<Long64_t> &file_duplicates, vector<double> &sample_duplicate_weights)
+{
+    InputReader reader;
+    for (size_t i=0; i<files.size(); i++)
+    {
+        bool opened = false;
+        for (const auto &range : done)
+        {
+            if (range.file != files[i]) continue;
+            if (!opened and !reader.Open(files[i])) break;
+            opened = true;
+            reader.Visit([&](auto *event)
+            {
+                for (Long64_t ievent=range.first; ievent<range.last; ievent++)
+                {
+                    event->GetEntry(ievent);
+                    if (!duplicates.Seen(dedup_key(file_source[i], event->Event_Number[0]), i, ievent)) continue;
+                    file_duplicates[i]++;
+                    sample_duplicate_weights[file_sample[i]] += event->Event_Weight[0];
+                }
+            });
+        }
+    }
+    reader.Close();
+}
+
+// Adds to the sums of weights the events of the inputs never read: the
+// zones ruled out by require=, and the events a skim dropped or a column
+// cache left out of each source, so these runs normalise like full ones.
+// Only the weights are read.
+void add_unread_weights(SampleSelection &selections, const vector<string> &files, const vector<int> &file_sample, const vector<Chunk> &ruled_out)
+{
+    for (size_t i=0; i<files.size(); i++)
+    {
+        double unread = 0;
+        if (is_column_cache(files[i]))
+        {
+            MappedColumns columns(files[i]);
+            const Float_t *weights = columns.Column<Float_t>("Event_Weight", 'F');
+            for (const Chunk &zone : ruled_out)
+            {
+                if (zone.file != (int) i) continue;
+                for (Long64_t ievent=zone.first; ievent<zone.last; ievent++) unread += weights == nullptr ? 1 : weights[ievent];
+            }
+            for (UInt_t s=0; s<columns.NSources(); s++) unread += columns.Source(s).dropped_weight;
+        }
+        else
+        {
+            TFile *infile = nullptr;
+            TTree *tree = nullptr;
+            bool flat = true;
+            for (const Chunk &zone : ruled_out)
+            {
+                if (zone.file != (int) i) continue;
+                if (infile == nullptr)
+                {
+                    infile = TFile::Open(files[i].c_str());
+                    if (infile == nullptr or infile->IsZombie()) break;
+                    infile->GetObject(FLAT_TREE_NAME, tree);
+                    if (tree == nullptr)
+                    {
+                        flat = false;
+                        infile->GetObject("Delphes", tree);
+                    }
+                }
+                if (tree != nullptr) unread += tree_sum_weights(tree, flat, zone.first, zone.last);
+            }
+            delete infile;
+            unread += skim_dropped_weight(files[i]);
+        }
+        if (unread != 0) selections[file_sample[i]].AddSkippedWeight(unread);
+    }
+}
+
+// Adds the entries of every histogram of plots to steps, by name
+void add_step_counts(const PlotSet &plots, vector<pair<string, double>> &steps)
+{
+    for (TH1 *hist : plots.histograms)
+    {
+        size_t i = 0;
+        while (i < steps.size() and steps[i].first != hist->GetName()) i++;
+        if (i == steps.size()) steps.push_back({hist->GetName(), 0});
+        steps[i].second += hist->GetEntries();
+    }
+}
+
+void run_fcc_higgs(TString infilename, TString outfilename, TString options = "")
+{
+    gErrorIgnoreLevel = kFatal;
+    ROOT::EnableThreadSafety();
+    // Histograms of the worker threads must not register in the shared gDirectory
+    TH1::AddDirectory(kFALSE);
+
+    RunOptions opt = parse_options(options);
+    vector<Sample> samples;
+    if (opt.catalogue) samples = read_sample_catalogue(infilename.Data());
+    else samples.push_back({"", 0, {infilename.Data()}});
+    if (!opt.sample_names.empty())
+    {
+        vector<Sample> selected;
+        for (const auto &sample : samples)
+        {
+            for (const auto &name : opt.sample_names)
+            {
+                if (sample.name == name or sample_process(sample.name) == name)
+                {
+                    selected.push_back(sample);
+                    break;
+                }
+            }
+        }
+        samples = selected;
+    }
+    // The files of all samples, and the sample of each
+    vector<string> files;
+    vector<int> file_sample;
+    for (size_t s=0; s<samples.size(); s++)
+    {
+        for (const auto &input : samples[s].inputs)
+        {
+            for (const auto &filename : expand_inputs(input.c_str()))
+            {
+                printf("Reading %s%s%s\n", filename.c_str(), opt.catalogue ? " for " : "", samples[s].name.c_str());
+                files.push_back(filename);
+                file_sample.push_back(s);
+            }
+        }
+    }
+
+    // v2 selects from all events, a vetoed input lacks most of them
+    for (size_t i=0; opt.v2 and i<files.size(); i++)
+    {
+        if (!is_vetoed_input(files[i])) continue;
+        printf("Option v2 needs full inputs, %s only holds events passing the lepton veto\n", files[i].c_str());
+        gSystem->Exit(1);
+    }
+
+    WorkStealingScheduler scheduler(opt.threads, opt.speculate);
+    ChunkSizer sizer(opt.target_seconds, opt.chunk_entries);
+    vector<Long64_t> file_entries;
+    vector<string> unreadable;
+    vector<Chunk> spans = plan_spans(files, scheduler, file_entries, unreadable);
+    if (!unreadable.empty())
+    {
+        // Their weight would still be in the sum of a catalogue, so the
+        // histograms would come out too low
+        printf("%zu inputs cannot be read, not running\n", unreadable.size());
+        gSystem->Exit(1);
+    }
+    Long64_t total_entries = 0;
+    for (Long64_t n : file_entries) total_entries += n;
+    printf("%lld events in %zu files, %d threads\n", total_entries, files.size(), opt.threads);
+    Long64_t skipped = 0;
+    vector<Chunk> ruled_out;
+    spans = skip_zones(spans, files, opt.requirements, skipped, ruled_out);
+    if (!opt.requirements.empty()) printf("Zone maps rule out %lld events\n", skipped);
+
+    // Source of the events of every file, for the duplicate check and the
+    // bootstrap weights
+    DuplicateFilter duplicates;
+    vector<ULong64_t> file_source;
+    for (size_t i=0; i<files.size(); i++) file_source.push_back(dedup_source(file_sample[i], files[i]));
+    vector<Long64_t> file_duplicates(files.size(), 0);
+    vector<double> sample_duplicate_weights(samples.size(), 0);
+
+    vector<SampleSelection *> selections;
+    for (int w=0; w<opt.threads; w++) selections.push_back(new SampleSelection(opt, samples));
+    vector<DecisionRecord> decisions;
+    vector<EventLocation> locations;
+
+    // Ranges whose events are in the histograms, for the checkpoints.
+    // Everything restored from a checkpoint lives in selections[0].
+    TString checkpoint_path = outfilename + ".checkpoint";
+    vector<EntryRange> done;
+    Long64_t restored = 0;
+    if (opt.resume and read_checkpoint(checkpoint_path, *selections[0], done))
+    {
+        spans = subtract_done(spans, files, done);
+        for (const auto &range : done) restored += range.last - range.first;
+        printf("Resuming from %s, %lld events already processed\n", checkpoint_path.Data(), restored);
+        if (opt.dedup) restore_duplicates(duplicates, files, file_source, file_sample, done, file_duplicates, sample_duplicate_weights);
+    }
+    scheduler.Submit(spans);
+
+    atomic<Long64_t> processed(0);
+    atomic<int> running_threads(opt.threads);
+    vector<double> file_seconds(files.size(), 0);
+    vector<double> thread_seconds(opt.threads, 0);
+    vector<ThreadMetrics> thread_metrics(opt.threads);
+    double read_seconds = 0;
+    auto run_start = chrono::steady_clock::now();
+    auto since_start = [&]() { return chrono::duration<double>(chrono::steady_clock::now() - run_start).count(); };
+    double wasted_seconds = 0;
+    mutex bookkeeping_mutex;
+    // Chunks whose file could not be opened by then, the run fails on them
+    vector<Chunk> unread_chunks;
+
+    auto work = [&](int w)
+    {
+        InputReader reader;
+        FILE *record = fopen(Form("%s.chunks.%d.tsv", outfilename.Data(), w), "w");
+        if (record != nullptr) fprintf(record, "%s", CHUNK_RECORD_HEADER);
+        int current_file = -1;
+        Chunk chunk;
+        TStopwatch timer;
+        // A chunk is filled into scratch first and only added to the
+        // thread's histograms if no other copy of it finished earlier
+        EngineSelection scratch(opt);
+        vector<DecisionRecord> scratch_decisions;
+        vector<EventLocation> scratch_locations;
+        double chunk_read_seconds = 0;
+        Long64_t scratch_selected = 0;
+        Long64_t scratch_duplicates = 0;
+        double scratch_duplicate_weight = 0;
+        while (true)
+        {
+            // Sized from the rate of the sample of the file, but never more
+            // than a fair share of what is left, so the last chunks get
+            // small and the threads finish together
+            Long64_t fair_share = TMath::Max(1LL, scheduler.Remaining() / (2 * opt.threads));
+            auto want = [&](const Chunk &span) { return TMath::Min((Long64_t) sizer.Size(file_sample[span.file]), fair_share); };
+            auto rate = [&](const Chunk &running) { return sizer.Rate(file_sample[running.file]); };
+            if (!scheduler.Next(w, chunk, want, rate)) break;
+
+            timer.Start();
+            if (w == opt.slow_thread) gSystem->Sleep(opt.slow_seconds * 1000);
+            if (chunk.file != current_file)
+            {
+                reader.Open(files[chunk.file]);
+                current_file = chunk.file;
+            }
+            scratch.Reset();
+            scratch_decisions.clear();
+            scratch_locations.clear();
+            chunk_read_seconds = 0;
+            scratch_selected = 0;
+            scratch_duplicates = 0;
+            scratch_duplicate_weight = 0;
+            bool unread = !reader.IsOpen();
+            bool cancelled = unread;
+            if (unread) printf("Cannot read Delphes tree from %s\n", files[chunk.file].c_str());
+            reader.Visit([&](auto *event)
+            {
+                for (Long64_t ievent=chunk.first; ievent < chunk.last and !cancelled; ievent++)
+                {
+                    auto read_start = chrono::steady_clock::now();
+                    event->GetEntry(ievent);
+                    chunk_read_seconds += chrono::duration<double>(chrono::steady_clock::now() - read_start).count();
+                    if (opt.dedup and duplicates.Seen(dedup_key(file_source[chunk.file], event->Event_Number[0]), chunk.file, ievent))
+                    {
+                        scratch_duplicates++;
+                        scratch_duplicate_weight += event->Event_Weight[0];
+                    }
+                    else if (!pass_requirements(opt.requirements, event)) scratch.SkipEvent(event->Event_Weight[0]);
+                    else
+                    {
+                        size_t selected = scratch.v3.selected_events.size();
+                        scratch.Process(event, file_source[chunk.file]);
+                        if (scratch.v3.selected_events.size() > selected) scratch_selected++;
+                        for (size_t i=selected; opt.events and i<scratch.v3.selected_events.size(); i++)
+                        {
+                            EventLocation location;
+                            location.file = chunk.file;
+                            location.entry = ievent;
+                            location.number = event->Event_Number[0];
+                            location.selected = scratch.v3.selected_events[i];
+                            scratch_locations.push_back(location);
+                        }
+                        if (opt.decisions and scratch.v3.PassedVeto())
+                        {
+                            DecisionRecord record;
+                            record.file = chunk.file;
+                            record.entry = ievent;
+                            scratch.v3.FillDecision(event, record);
+                            scratch_decisions.push_back(record);
+                        }
+                    }
+                    if ((ievent - chunk.first) % 1000 == 999) cancelled = scheduler.Cancelled(chunk);
+                }
+            });
+            timer.Stop();
+
+            unique_lock<mutex> lock(bookkeeping_mutex);
+            thread_seconds[w] += timer.RealTime();
+            read_seconds += chunk_read_seconds;
+            bool first_done = scheduler.Finish(chunk);
+            if (!first_done or cancelled)
+            {
+                // Lost nothing if another copy of the chunk was read
+                if (first_done and unread) unread_chunks.push_back(chunk);
+                wasted_seconds += timer.RealTime();
+                continue;
+            }
+            (*selections[w])[file_sample[chunk.file]].Add(scratch);
+            decisions.insert(decisions.end(), scratch_decisions.begin(), scratch_decisions.end());
+            locations.insert(locations.end(), scratch_locations.begin(), scratch_locations.end());
+            file_duplicates[chunk.file] += scratch_duplicates;
+            sample_duplicate_weights[file_sample[chunk.file]] += scratch_duplicate_weight;
+            done.push_back({files[chunk.file], chunk.first, chunk.last});
+            thread_metrics[w].events += chunk.Entries();
+            thread_metrics[w].last_chunk = since_start();
+            sizer.Record(chunk.Entries(), timer.RealTime(), file_sample[chunk.file]);
+
+            Long64_t processed_now = processed += chunk.Entries();
+            file_seconds[chunk.file] += timer.RealTime();
+            lock.unlock();
+
+            if (record != nullptr)
+            {
+                fprintf(record, "%d\t%s\t%lld\t%lld\t%lld\t%.3f\t%.1f\t%d\t%lld\n", w, files[chunk.file].c_str(), chunk.first, chunk.last,
+                        chunk.Entries(), timer.RealTime(), chunk.Entries() / TMath::Max(timer.RealTime(), 1e-9), chunk.speculative,
+                        scratch_selected);
+                fflush(record);
+            }
+            printf("Processed %lld / %lld events (chunk of %lld%s)\n", processed_now, total_entries - skipped, chunk.Entries(), chunk.speculative ? ", speculative" : "");
+        }
+        reader.Close();
+        if (record != nullptr) fclose(record);
+        {
+            lock_guard<mutex> lock(bookkeeping_mutex);
+            thread_metrics[w].running = false;
+        }
+        running_threads--;
+    };
+
+    // Snapshot under the bookkeeping lock, so the histograms and the
+    // list of ranges agree, then write outside of it
+    SampleSelection snapshot(opt, samples);
+    auto save_checkpoint = [&]()
+    {
+        vector<EntryRange> snapshot_done;
+        snapshot.Reset();
+        {
+            lock_guard<mutex> lock(bookkeeping_mutex);
+            for (int w=0; w<opt.threads; w++) snapshot.Add(*selections[w]);
+            snapshot_done = done;
+        }
+        if (!write_checkpoint(checkpoint_path, snapshot, snapshot_done)) printf("Cannot write %s\n", checkpoint_path.Data());
+    };
+
+    TString metrics_path = outfilename + ".metrics.json";
+    auto save_metrics = [&](bool finished)
+    {
+        RunMetrics metrics;
+        {
+            lock_guard<mutex> lock(bookkeeping_mutex);
+            metrics.threads = thread_metrics;
+            for (int w=0; w<opt.threads; w++) metrics.threads[w].busy_seconds = thread_seconds[w];
+            metrics.read_seconds = read_seconds;
+            for (int w=0; w<opt.threads; w++)
+            {
+                for (size_t s=0; s<samples.size(); s++)
+                {
+                    add_step_counts((*selections[w])[s].v3.plots_mutaue, metrics.steps);
+                    add_step_counts((*selections[w])[s].v3.plots_etaumu, metrics.steps);
+                }
+            }
+        }
+        metrics.elapsed = since_start();
+        metrics.processed = processed;
+        metrics.total = total_entries - skipped - restored;
+        metrics.bytes_read = TFile::GetFileBytesRead();
+        ProcInfo_t info;
+        if (gSystem->GetProcInfo(&info) == 0) metrics.rss_kb = info.fMemResident;
+        metrics.finished = finished;
+        if (!write_metrics(metrics_path, metrics)) printf("Cannot write %s\n", metrics_path.Data());
+    };
+
+    TStopwatch wall;
+    wall.Start();
+    vector<thread> threads;
+    for (int w=0; w<opt.threads; w++) threads.emplace_back(work, w);
+    TStopwatch since_checkpoint;
+    since_checkpoint.Start();
+    double last_metrics = 0;
+    while (running_threads > 0)
+    {
+        this_thread::sleep_for(chrono::milliseconds(500));
+        if (opt.metrics_seconds > 0 and since_start() - last_metrics > opt.metrics_seconds)
+        {
+            save_metrics(false);
+            last_metrics = since_start();
+        }
+        if (opt.checkpoint_seconds > 0 and since_checkpoint.RealTime() > opt.checkpoint_seconds)
+        {
+            save_checkpoint();
+            since_checkpoint.Start();
+        }
+        else since_checkpoint.Continue();
+    }
+    for (auto &t : threads) t.join();
+    wall.Stop();
+    if (opt.metrics_seconds > 0) save_metrics(true);
+    if (!unread_chunks.empty())
+    {
+        // No output without their events; a checkpoint keeps what was done,
+        // so a resume only reads them again
+        for (const auto &unread : unread_chunks) printf("Not read: %s entries %lld-%lld\n", files[unread.file].c_str(), unread.first, unread.last);
+        if (opt.checkpoint_seconds > 0) save_checkpoint();
+        printf("%zu chunks could not be read, not writing %s\n", unread_chunks.size(), outfilename.Data());
+        gSystem->Exit(1);
+    }
+
+    // One chunk log from the records of the threads
+    FILE *chunklog = fopen(Form("%s.chunks.tsv", outfilename.Data()), "w");
+    if (chunklog != nullptr) fprintf(chunklog, "%s", CHUNK_RECORD_HEADER);
+    for (int w=0; w<opt.threads; w++)
+    {
+        TString record_path = Form("%s.chunks.%d.tsv", outfilename.Data(), w);
+        ifstream record(record_path.Data());
+        string line;
+        getline(record, line);
+        while (chunklog != nullptr and getline(record, line)) fprintf(chunklog, "%s\n", line.c_str());
+        record.close();
+        gSystem->Unlink(record_path);
+    }
+    if (chunklog != nullptr) fclose(chunklog);
+
+    for (int w=1; w<opt.threads; w++) selections[0]->Add(*selections[w]);
+    add_unread_weights(*selections[0], files, file_sample, ruled_out);
+    if (opt.dedup)
+    {
+        Long64_t dropped = 0;
+        FILE *report = fopen(Form("%s.duplicates.tsv", outfilename.Data()), "w");
+        if (report != nullptr) fprintf(report, "file\tentries\tduplicates\n");
+        for (size_t i=0; i<files.size(); i++)
+        {
+            dropped += file_duplicates[i];
+            if (file_duplicates[i] > 0) printf("%lld duplicate events in %s\n", file_duplicates[i], files[i].c_str());
+            if (report != nullptr) fprintf(report, "%s\t%lld\t%lld\n", files[i].c_str(), file_entries[i], file_duplicates[i]);
+        }
+        if (report != nullptr) fclose(report);
+        for (size_t s=0; s<samples.size(); s++) selections[0]->DropWeight(s, sample_duplicate_weights[s]);
+        printf("Dropped %lld duplicate events of %lld distinct ones\n", dropped, duplicates.Size());
+    }
+
+    TFile *outfile = new TFile(outfilename, "RECREATE");
+    selections[0]->SaveScaled(outfile, opt.lumi);
+    outfile->Close();
+    if (opt.checkpoint_seconds > 0 or opt.resume) gSystem->Unlink(checkpoint_path);
+
+    if (opt.decisions)
+    {
+        TString decisions_path = outfilename + ".decisions.root";
+        if (write_decisions(decisions_path, files, decisions)) printf("Wrote decisions of %zu events to %s\n", decisions.size(), decisions_path.Data());
+        else printf("Cannot write %s\n", decisions_path.Data());
+    }
+    if (opt.events)
+    {
+        TString events_path = outfilename + ".events.root";
+        if (write_selected_locations(events_path, files, locations)) printf("Wrote locations of %zu selected events to %s\n", locations.size(), events_path.Data());
+        else printf("Cannot write %s\n", events_path.Data());
+    }
+
+    FILE *timing = fopen(Form("%s.timing.tsv", outfilename.Data()), "w");
+    if (timing != nullptr)
+    {
+        fprintf(timing, "file\tentries\tseconds\n");
+        for (size_t i=0; i<files.size(); i++) fprintf(timing, "%s\t%lld\t%.3f\n", files[i].c_str(), file_entries[i], file_seconds[i]);
+        fclose(timing);
+    }
+
+    double busy = 0;
+    for (double s : thread_seconds) busy += s;
+    printf("Wall time %.2f s, %.2f events/s\n", wall.RealTime(), processed / wall.RealTime());
+    printf("Thread utilisation %.2f, %d steals, final rate %.1f events/s per thread\n",
+           busy / (opt.threads * wall.RealTime()), scheduler.Steals(), sizer.Rate());
+    printf("Speculative copies %d, %d finished first, %.2f thread-seconds discarded\n",
+           scheduler.Speculated(), scheduler.SpeculativeWins(), wasted_seconds);
+}
@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <ROOT/TBufferMerger.hxx>
+#include <TParameter.h>
+#include <TStopwatch.h>
+#include "run-fcc-higgs.cpp"
+
+using namespace std;
+
+/*
+Multithreaded skimmer for the e+mu analyses.
+
+Keeps only the events passing the lepton veto of the v3 selection (exactly
+one muon with pT > 10 GeV and one electron with pT > 5 GeV, |eta| < 6) and
+only the columns the selection reads (the same as extractor.py). The skim
+keeps the Delphes layout, so read_fcc_higgs_v3 and run_fcc_higgs run on it
+unchanged and give the same histograms as on the original files: the veto
+is the first thing the selection does, also before the "no cuts" step.
+
+    root -l -b -q "skim-fcc-higgs.cpp(\"INPUT\", \"OUTPUT\", \"threads=20\")"
+
+INPUT is a glob or @list.txt as for run_fcc_higgs, and the files are
+shared between the threads with the same scheduler (threads=, chunk=,
+target= work the same way, there are no speculative copies). Every thread
+writes its events through a TBufferMerger into the one OUTPUT, so the
+order of the events in the skim is not the order of the input; use
+Event.Number to match them. The numbers of input and kept events are
+stored in OUTPUT as skim_input_entries and skim_output_entries, the sum of
+the event weights of the input as skim_input_sum_weights (the v3 macro,
+the worker and the engine add the weight of the dropped events to their
+sum_weights with it, so a skim normalises like its input), and its
+zone map (fcc-higgs-zonemap.h) as the tree zonemap, for run_fcc_higgs
+with require=.
+
+An input that cannot be read, at the start or later on, fails the skim:
+nothing is written and the macro exits non-zero.
+
+With the option "flat" the skim is written in the flat layout of
+fcc-higgs-flat.h instead, which the v3 macro and the engine also read.
+*/
+
+const vector<string> SKIM_BRANCHES = {
+    "Jet.PT", "Jet.Eta", "Jet.Phi", "Jet.BTag", "Jet.TauTag", "Jet.Charge", "Jet.Mass", "Jet_size",
+    "Muon.PT", "Muon.Eta", "Muon.Phi", "Muon.Charge", "Muon_size",
+    "Electron.PT", "Electron.Eta", "Electron.Phi", "Electron.Charge", "Electron_size",
+    "MissingET.Phi", "MissingET.MET",
+    "Event.Number", "Event.Weight",
+};
+
+void set_skim_branches(TTree *tree)
+{
+    tree->SetBranchStatus("*", 0);
+    for (const auto &branch : SKIM_BRANCHES) tree->SetBranchStatus(branch.c_str(), 1);
+}
+
+TTree *open_delphes_tree(const string &filename)
+{
+    TFile *infile = TFile::Open(filename.c_str());
+    TTree *tree = nullptr;
+    if (infile != nullptr and !infile->IsZombie()) infile->GetObject("Delphes", tree);
+    if (tree == nullptr) delete infile;
+    return tree;
+}
+
+// Zone map of a finished skim, one zone per cluster of its event tree
+vector<Zone> build_zone_map(const string &filename)
+{
+    vector<Zone> zones;
+    vector<long long> cluster_ends;
+    TTree *tree = open_delphes_tree(filename);
+    if (tree == nullptr)
+    {
+        TFile *infile = TFile::Open(filename.c_str());
+        if (infile != nullptr) infile->GetObject(FLAT_TREE_NAME, tree);
+        if (tree == nullptr) delete infile;
+    }
+    if (tree == nullptr) return zones;
+    cluster_ends = tree_cluster_ends(tree);
+    delete tree->GetCurrentFile();
+
+    InputReader reader;
+    if (!reader.Open(filename)) return zones;
+    reader.Visit([&](auto *event)
+    {
+        Long64_t first = 0;
+        for (long long end : cluster_ends)
+        {
+            Zone zone;
+            zone.Start(first);
+            for (Long64_t ievent=first; ievent < end; ievent++)
+            {
+                event->GetEntry(ievent);
+                zone.Add(event);
+            }
+            if (end > first) zones.push_back(zone);
+            first = end;
+        }
+    });
+    return zones;
+}
+
+void skim_fcc_higgs(TString infilename, TString outfilename, TString options = "")
+{
+    gErrorIgnoreLevel = kFatal;
+    ROOT::EnableThreadSafety();
+
+    RunOptions opt = parse_options(options);
+    vector<string> files = expand_inputs(infilename);
+    for (const auto &filename : files) printf("Reading %s\n", filename.c_str());
+
+    // A copy of a chunk cannot be taken back out of the merger, so no speculation
+    WorkStealingScheduler scheduler(opt.threads);
+    ChunkSizer sizer(opt.target_seconds, opt.chunk_entries);
+    vector<Long64_t> file_entries;
+    vector<string> unreadable;
+    vector<Chunk> spans = plan_spans(files, scheduler, file_entries, unreadable);
+    if (!unreadable.empty())
+    {
+        // Their events and weight would be missing from the skim
+        printf("%zu inputs cannot be read, not skimming\n", unreadable.size());
+        gSystem->Exit(1);
+    }
+    Long64_t total_entries = 0;
+    for (Long64_t n : file_entries) total_entries += n;
+    printf("%lld events in %zu files, %d threads\n", total_entries, files.size(), opt.threads);
+    scheduler.Submit(spans);
+
+    atomic<Long64_t> processed(0);
+    atomic<Long64_t> kept(0);
+    atomic<int> unread_chunks(0);
+    vector<double> thread_sum_weights(opt.threads, 0);
+    TStopwatch wall;
+    wall.Start();
+    {
+        ROOT::TBufferMerger merger(outfilename);
+
+        auto work = [&](int w)
+        {
+            auto outfile = merger.GetFile();
+            Delphes *indelphes = nullptr;
+            TTree *outtree = nullptr;
+            FlatEvent flatout;
+            if (opt.flat)
+            {
+                outfile->cd();
+                outtree = new TTree(FLAT_TREE_NAME, "flat skim");
+                flatout.Book(outtree);
+            }
+            int current_file = -1;
+            bool readable = false;
+            Chunk chunk;
+            TStopwatch timer;
+            while (true)
+            {
+                Long64_t fair_share = TMath::Max(1LL, scheduler.Remaining() / (2 * opt.threads));
+                auto want = [&](const Chunk &span) { return TMath::Min((Long64_t) sizer.Size(span.file), fair_share); };
+                if (!scheduler.Next(w, chunk, want, [](const Chunk &) { return 0.0; })) break;
+
+                timer.Start();
+                if (chunk.file != current_file)
+                {
+                    current_file = chunk.file;
+                    TTree *intree = open_delphes_tree(files[chunk.file]);
+                    readable = intree != nullptr;
+                    if (!readable) printf("Cannot read Delphes tree from %s\n", files[chunk.file].c_str());
+                    else
+                    {
+                        // One reader per thread, so the output branches keep
+                        // pointing at the same buffers from file to file
+                        TFile *previous = indelphes == nullptr ? nullptr : indelphes->fChain->GetCurrentFile();
+                        if (indelphes == nullptr) indelphes = new Delphes(intree);
+                        else indelphes->Init(intree);
+                        set_skim_branches(intree);
+                        if (outtree == nullptr)
+                        {
+                            outfile->cd();
+                            outtree = intree->CloneTree(0);
+                        }
+                        delete previous;
+                        if (!opt.flat)
+                        {
+                            // Deleting the previous input resets the addresses
+                            // of its clone, so point them at the reader again
+                            intree->AddClone(outtree);
+                            intree->CopyAddresses(outtree);
+                        }
+                    }
+                }
+                if (!readable)
+                {
+                    unread_chunks++;
+                    scheduler.Finish(chunk);
+                    continue;
+                }
+
+                Long64_t chunk_kept = 0;
+                for (Long64_t ievent=chunk.first; ievent < chunk.last; ievent++)
+                {
+                    indelphes->GetEntry(ievent);
+                    thread_sum_weights[w] += indelphes->Event_Weight[0];
+                    if (!pass_lepton_veto(indelphes)) continue;
+                    if (opt.flat) flatout.CopyFrom(indelphes);
+                    outtree->Fill();
+                    chunk_kept++;
+                }
+                // Hand the filled baskets over to the merger; flat skims only
+                // once a cluster is complete, to keep the clusters large
+                if (!opt.flat or outtree->GetZipBytes() > 0) outfile->Write();
+                timer.Stop();
+                scheduler.Finish(chunk);
+                sizer.Record(chunk.Entries(), timer.RealTime(), chunk.file);
+
+                kept += chunk_kept;
+                Long64_t done = processed += chunk.Entries();
+                printf("Processed %lld / %lld events, kept %lld\n", done, total_entries, (Long64_t) kept);
+            }
+            if (outtree != nullptr) outfile->Write();
+            delete indelphes;
+        };
+
+        vector<thread> threads;
+        for (int w=0; w<opt.threads; w++) threads.emplace_back(work, w);
+        for (auto &t : threads) t.join();
+    }
+    if (unread_chunks > 0)
+    {
+        // Their weight is not in skim_input_sum_weights, so no skim at all
+        printf("%d chunks could not be read, removing %s\n", (int) unread_chunks, outfilename.Data());
+        gSystem->Unlink(outfilename);
+        gSystem->Exit(1);
+    }
+    vector<Zone> zones = build_zone_map(outfilename.Data());
+    wall.Stop();
+
+    TFile *outfile = new TFile(outfilename, "UPDATE");
+    write_zone_map(outfile, zones);
+    TParameter<Long64_t> input_entries("skim_input_entries", (Long64_t) processed);
+    TParameter<Long64_t> output_entries("skim_output_entries", (Long64_t) kept);
+    double sum_weights = 0;
+    for (double s : thread_sum_weights) sum_weights += s;
+    TParameter<double> input_sum_weights("skim_input_sum_weights", sum_weights);
+    outfile->WriteTObject(&input_entries);
+    outfile->WriteTObject(&output_entries);
+    outfile->WriteTObject(&input_sum_weights);
+    outfile->Close();
+    delete outfile;
+
+    printf("Kept %lld of %lld events (%.2f%%) in %.2f s, %.2f events/s\n", (Long64_t) kept, (Long64_t) processed,
+           100. * kept / TMath::Max(1LL, (Long64_t) processed), wall.RealTime(), processed / wall.RealTime());
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <TKey.h>
+#include <TParameter.h>
+#include "run-fcc-higgs.cpp"
+
+using namespace std;
+
+/*
+Stitches the components of a process (fcc-higgs-samples.h) anew from the
+outputs of catalogue runs of the engine, so a new production is processed
+on its own and combined with the ones already processed:
+
+    root -l -b -q "run-fcc-higgs.cpp(\"catalogue.tsv\", \"set3.root\", \"catalogue samples=ttbar_hvq/hvqMulti10M_set3\")"
+    root -l -b -q "stitch-fcc-higgs.cpp(\"all_engine.root,set3.root\", \"stitched.root\", \"\")"
+
+INPUT is a comma separated list of outputs (each a glob or @list.txt).
+Every sample directory of them holds its scale, cross-section and sum of
+weights (save_scaled); its histograms are unscaled with the first, and all
+samples are saved again as the engine does (SampleSelection::SaveScaled),
+the components of every process stitched with their summed sums of
+weights. A sample found in several inputs is taken from the last one, so a
+reprocessed production replaces the old one. OPTIONS are those of the
+engine runs (v2, control, universes=, bootstrap=, lumi=), so the same
+directories are read and written.
+*/
+
+struct StoredSample
+{
+    Sample sample;
+    TDirectory *dir;
+    double scale;
+};
+
+// The parameters save_scaled wrote to dir, false if any is missing
+bool read_scaled_parameters(TDirectory *dir, StoredSample &stored)
+{
+    TParameter<double> *scale = nullptr;
+    TParameter<double> *cross_section = nullptr;
+    TParameter<double> *sum_weights = nullptr;
+    dir->GetObject("scale", scale);
+    dir->GetObject("cross_section", cross_section);
+    dir->GetObject("norm_sum_weights", sum_weights);
+    bool found = scale != nullptr and cross_section != nullptr and sum_weights != nullptr;
+    if (found)
+    {
+        stored.dir = dir;
+        stored.scale = scale->GetVal();
+        stored.sample.cross_section = cross_section->GetVal();
+        stored.sample.sum_weights = sum_weights->GetVal();
+        stored.sample.known = true;
+    }
+    delete scale;
+    delete cross_section;
+    delete sum_weights;
+    return found;
+}
+
+// The subdirectories of dir
+vector<TDirectory *> subdirectories(TDirectory *dir)
+{
+    vector<TDirectory *> subdirs;
+    TList *keys = dir->GetListOfKeys();
+    for (int i=0; keys != nullptr and i<keys->GetEntries(); i++)
+    {
+        TKey *key = (TKey *) keys->At(i);
+        if (TString(key->GetClassName()) != "TDirectoryFile") continue;
+        TDirectory *subdir = dir->GetDirectory(key->GetName());
+        if (subdir != nullptr) subdirs.push_back(subdir);
+    }
+    return subdirs;
+}
+
+// Adds stored to samples, replacing a sample of the same name
+void add_stored_sample(vector<StoredSample> &samples, const StoredSample &stored)
+{
+    for (auto &sample : samples)
+    {
+        if (sample.sample.name != stored.sample.name) continue;
+        printf("%s replaced by %s\n", sample.sample.name.c_str(), stored.dir->GetPath());
+        sample = stored;
+        return;
+    }
+    samples.push_back(stored);
+}
+
+void stitch_fcc_higgs(TString infilenames, TString outfilename, TString options = "")
+{
+    gErrorIgnoreLevel = kFatal;
+    TH1::AddDirectory(kFALSE);
+
+    RunOptions opt = parse_options(options);
+    vector<TFile *> infiles;
+    vector<StoredSample> stored;
+    istringstream inputs(infilenames.Data());
+    string input;
+    while (getline(inputs, input, ','))
+    {
+        for (const auto &filename : expand_inputs(input.c_str()))
+        {
+            TFile *infile = TFile::Open(filename.c_str());
+            if (infile == nullptr or infile->IsZombie())
+            {
+                printf("Cannot read %s\n", filename.c_str());
+                delete infile;
+                continue;
+            }
+            infiles.push_back(infile);
+            // A process directory holds its components, any other one a sample
+            for (TDirectory *dir : subdirectories(infile))
+            {
+                bool components = false;
+                for (TDirectory *subdir : subdirectories(dir))
+                {
+                    StoredSample component;
+                    if (!read_scaled_parameters(subdir, component)) continue;
+                    component.sample.name = Form("%s/%s", dir->GetName(), subdir->GetName());
+                    add_stored_sample(stored, component);
+                    components = true;
+                }
+                StoredSample sample;
+                if (components or !read_scaled_parameters(dir, sample)) continue;
+                sample.sample.name = dir->GetName();
+                add_stored_sample(stored, sample);
+            }
+        }
+    }
+    if (stored.empty())
+    {
+        printf("No scaled samples in %s\n", infilenames.Data());
+        return;
+    }
+
+    vector<Sample> samples;
+    for (const auto &sample : stored) samples.push_back(sample.sample);
+    SampleSelection selection(opt, samples);
+    for (size_t s=0; s<stored.size(); s++)
+    {
+        printf("Reading %s from %s\n", stored[s].sample.name.c_str(), stored[s].dir->GetPath());
+        selection[s].LoadAll(stored[s].dir);
+        selection[s].Scale(stored[s].scale == 0 ? 0 : 1 / stored[s].scale);
+    }
+
+    TFile *outfile = new TFile(outfilename, "RECREATE");
+    selection.SaveScaled(outfile, opt.lumi);
+    outfile->Close();
+    for (TFile *infile : infiles) infile->Close();
+}